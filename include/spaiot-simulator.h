@@ -1,2 +1,9 @@
 #pragma once
-#include "spaiot/simulator/engine.h"
\ No newline at end of file
+#include "spaiot/simulator/engine.h"
+#include "spaiot/simulator/spibus.h"
+#include "spaiot/simulator/faultbus.h"
+#include "spaiot/simulator/loopbackbus.h"
+#include "spaiot/simulator/scenario.h"
+#include "spaiot/simulator/batchrunner.h"
+#include "spaiot/simulator/spamodel.h"
+#include "spaiot/simulator/spadevice.h"
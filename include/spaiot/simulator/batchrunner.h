@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "scenario.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @brief Result of a scenario run by BatchRunner
+  */
+  struct BatchResult {
+    bool passed;           ///< true if all the expect steps succeeded
+    std::string failure;   ///< description of the expect step that failed
+    unsigned long polls;   ///< number of poll() cycles run
+    uint64_t virtualTime;  ///< virtual time of the bus at the end of the run in microseconds
+    double wallTime;       ///< time taken by the run in milliseconds
+  };
+
+  /**
+     @class BatchRunner
+     @brief Runs independent scenarios in parallel
+
+     Each scenario runs against its own Engine, SpaDevice and LoopbackBus, the workers
+     share no mutable state except the queues of scenarios. The scenarios are spread
+     over one queue per worker, a worker that empties its queue steals from the others.
+     The results are stored by scenario index, so they do not depend on the number of
+     threads (except wallTime).
+  */
+  class BatchRunner {
+    public:
+      /**
+         @brief Constructor
+
+         @param threads number of workers, 0 for the number of cores
+      */
+      explicit BatchRunner (unsigned threads = 0);
+
+      /**
+         @brief Run the scenarios
+
+         @return results in the order of the scenarios
+      */
+      std::vector<BatchResult> run (const std::vector<Scenario> &scenarios) const;
+
+      /**
+         @brief Number of workers
+      */
+      unsigned threads() const;
+
+      /**
+         @brief Run a scenario in the calling thread
+      */
+      static BatchResult runOne (const Scenario &scenario);
+
+    private:
+      unsigned m_threads;
+  };
+}
@@ -1,14 +1,81 @@
 #pragma once
 
+#include <cstdint>
 #include <array>
+#include <string>
 
 namespace SpaIotSimulator {
 
+  /**
+     @brief Status codes
+
+     Returned by the engine and bus functions instead of throwing exceptions,
+     so they can be used in a real-time loop built with -fno-exceptions.
+  */
+  enum Status {
+    StatusOk = 0,
+    StatusOutOfRange, ///< value out of range
+    StatusBadId,      ///< led or button identifier out of range
+    StatusIoError     ///< system call failure, see Bus::lastError()
+  };
+
+  /**
+     @brief Bus timing profile
+
+     Delays used by Bus::transfer() between the pin writes of each bit.
+     The default values are the spec minimums, they do not take into account
+     the time spent in digitalWrite() and delayMicroseconds().
+     Bus::calibrate() measures these costs on the running board and
+     computes the shortest delays that meet the spec minimums.
+  */
+  struct BusTiming {
+    /**
+       @brief Constructor, sets the uncalibrated delays
+    */
+    BusTiming();
+
+    /**
+       @brief Load a profile saved by save()
+
+       The profile is rejected if it has been measured on another platform
+       or if its delays do not meet the spec minimums (see isValid()).
+       @param path profile file path
+       @param platform identity of the board and of the GPIO library measured, eg "Raspberry Pi 3 Model B, piduino 0.4.0"
+       @return true if the profile has been read and can be used
+    */
+    bool load (const std::string &path, const std::string &platform);
+
+    /**
+       @brief Save the profile
+
+       @param path profile file path
+       @param platform identity of the board and of the GPIO library measured
+       @return true if the profile has been written
+    */
+    bool save (const std::string &path, const std::string &platform) const;
+
+    /**
+       @brief Check the delays against the spec minimums
+
+       @return true if each half clock period (pin write + delay) is not shorter than the spec minimum
+    */
+    bool isValid() const noexcept;
+
+    uint16_t clkLow;    ///< delay after SClk falling edge in microseconds, 0 for no delay call
+    uint16_t dataSetup; ///< delay after SDataOut change in microseconds, 0 for no delay call
+    uint16_t clkHigh;   ///< delay after SClk rising edge in microseconds, 0 for no delay call
+    uint32_t writeNs;   ///< measured time of a pin write in nanoseconds
+    uint32_t delayNs;   ///< measured overhead of a delay call in nanoseconds
+    uint32_t frameNs;   ///< measured time of a frame in nanoseconds
+  };
+
   /**
      @class Bus
      @brief Spa bus
 
      This class simulates the SPI bus used by the Spa device.
+     The frames are bit-banged on GPIO pins, derived classes can override
+     transfer(), freeze() and flush() to use another backend (see SpiBus).
   */
   class Bus {
     public:
@@ -20,16 +87,29 @@ namespace SpaIotSimulator {
          @param clkPin Clock pin number, this pin sample the data pin
          @param dataOutPin Data output pin number, the frame is outputed on this pin
          @param nWrPin write pin number, this pin is set to low when the data is outputed by dataOutPin, high when reading dataInPin
-         @param dataInPin Data input pin number, this pin permit to read buttons states
+         @param dataInPin Data input pin number, this pin permit to read buttons states, -1 if not wired (no button pressed)
       */
       Bus (int clkPin, int dataOutPin, int nWrPin, int dataInPin);
 
+      /**
+         @brief Destructor
+      */
+      virtual ~Bus();
+
       /**
          @brief Initialize the pins of the bus
 
          The output pins are set to high, the input pin is set to input.
+         @return StatusOk, or StatusIoError for the backends which open a device
       */
-      void begin();
+      virtual Status begin() noexcept;
+
+      /**
+         @brief Start of a poll() cycle
+
+         Called by Engine::poll() before the first frame, does nothing by default.
+      */
+      virtual void beginCycle() noexcept;
 
       /**
          @brief Transfer a frame on the bus
@@ -38,14 +118,85 @@ namespace SpaIotSimulator {
          The timing is in concordance with the Spa device.
          @param data The frame to transfer
       */
-      void transfer (uint16_t data);
+      virtual void transfer (uint16_t data) noexcept;
+
+      /**
+         @brief Freeze the bus after the last frame
+
+         The bus stays idle (nWR high) during the delay.
+         Backends that queue frames may add the delay to the last queued frame instead of waiting.
+         @param us Delay in microseconds
+      */
+      virtual void freeze (uint16_t us) noexcept;
+
+      /**
+         @brief Send the frames that are still queued
+
+         Does nothing for the GPIO backend which transfers the frames immediately.
+         A failure is reported by lastError().
+      */
+      virtual void flush() noexcept;
 
       /**
          @brief Read the data in pin state
 
+         The frames still queued are sent before reading.
          @return true if the data in pin is high
       */
-      bool dataInPin ();
+      virtual bool dataInPin () noexcept;
+
+      /**
+         @brief Measure the pin write and delay costs on the running board
+
+         The cost of digitalWrite() is measured by toggling SDataOut with nWR high,
+         the overhead of delayMicroseconds() with a 1 µs delay, the minimum over
+         several runs is kept. The delays are computed so that each half clock
+         period (pin write + delay) is not shorter than the spec minimum, then
+         the time of a frame is measured with these delays.
+
+         The timing of the bus is not modified, call setTiming() to use the result.
+         @param frame frame transferred to measure the frame time, should be an idle frame
+         @return the timing profile
+      */
+      virtual BusTiming calibrate (uint16_t frame);
+
+      /**
+         @brief Set the delays used by transfer()
+      */
+      virtual void setTiming (const BusTiming &timing) noexcept;
+
+      /**
+         @brief Get the delays used by transfer()
+      */
+      virtual const BusTiming &timing() const noexcept;
+
+      /**
+         @brief Get the last error
+
+         @return errno value of the last system call that failed, 0 if none
+      */
+      virtual int lastError() const noexcept;
+
+      /**
+         @brief Clear the last error, called by Engine::poll() before each cycle
+      */
+      virtual void clearError() noexcept;
+
+    protected:
+      /**
+         @brief Number of runs of each calibration measurement, the minimum is kept
+      */
+      static const int CalibrationRuns = 8;
+
+      /**
+         @brief Set the value returned by lastError()
+      */
+      void setError (int error) noexcept;
+
+      /**
+         @brief Monotonic time in nanoseconds, used for the measurements
+      */
+      static uint64_t nanos();
 
     private:
       enum Pins {
@@ -55,6 +206,8 @@ namespace SpaIotSimulator {
         SDataIn // must be the last one
       };
       std::array < int, SDataIn + 1 > m_pin;
+      BusTiming m_timing;
+      int m_error;
   };
 
 }
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <array>
+#include <memory>
 #include "bus.h"
 
 namespace SpaIotSimulator {
@@ -43,6 +44,11 @@ namespace SpaIotSimulator {
      @brief Engine simulator
 
      This class simulates the Spa device.
+
+     Except the constructors and calibrate(), the functions do not throw and do not
+     allocate memory, the errors are reported by status codes (see Status). When the
+     led or button identifier is a compile-time constant, the template versions check
+     it at compile time, eg setLed<LedPower>().
   */
   class Engine {
     public:
@@ -53,13 +59,22 @@ namespace SpaIotSimulator {
       */
       Engine (int clkPin, int dataOutPin, int nWrPin, int dataInPin);
 
+      /**
+         @brief Constructor with an external bus
+
+         Same as above but the frames are transferred on the bus provided
+         (eg a SpiBus), the bus must outlive the engine.
+      */
+      explicit Engine (Bus &bus);
+
       /**
          @brief Initialize the engine
 
          This function must be called once before any other call to the engine.
          It initializes the SPI bus and the engine internal state.
+         @return StatusOk, or the error returned by Bus::begin()
       */
-      void begin();
+      Status begin() noexcept;
 
       /**
          @brief Poll the engine
@@ -72,52 +87,88 @@ namespace SpaIotSimulator {
          This sequence is repeated 5 times with a delay of 260 microseconds between each frame.
          Terminates by a scan of the buttons and return the button states.
 
-         @return uint16_t the button states, each bit represents a button state, 1 for pressed, 0 for released, the bit order is defined by the ButtonId enum.
+         @return uint16_t the button states, each bit represents a button state, 1 for pressed, 0 for released, the bit order is defined by the ButtonId enum,
+                 -1 if the bus failed during the cycle (see Bus::lastError()), the button states are then not valid.
       */
-      int poll();
+      int poll() noexcept;
 
       /**
          @brief Set the Led state which is send by the next poll() call
 
          @param id Led identifier, see LedId enum
          @param state Led state, true for on, false for off, default is true
+         @return StatusOk, StatusBadId if id is out of range
       */
-      void setLed (int id, bool state = true);
+      Status setLed (int id, bool state = true) noexcept;
 
       /**
          @brief Clear the Led state which is send by the next poll() call
 
          @param id Led identifier, see LedId enum
+         @return StatusOk, StatusBadId if id is out of range
       */
-      void clearLed (int id);
+      Status clearLed (int id) noexcept;
 
       /**
          @brief Toggle the Led state which is send by the next poll() call
 
          @param id Led identifier, see LedId enum
+         @return StatusOk, StatusBadId if id is out of range
       */
-      void toggleLed (int id);
+      Status toggleLed (int id) noexcept;
 
       /**
          @brief Get the Led state internally stored
 
          @param id Led identifier, see LedId enum
+         @return the Led state, false if id is out of range
+      */
+      bool led (int id) const noexcept;
+
+      /**
+         @brief Set the Led state, the identifier is checked at compile time
+      */
+      template <int Id> void setLed (bool state = true) noexcept {
+        static_assert (Id >= 0 && Id < NofLeds, "Led identifier out of range");
+        m_led[Id] = state;
+      }
+
+      /**
+         @brief Clear the Led state, the identifier is checked at compile time
+      */
+      template <int Id> void clearLed() noexcept {
+        setLed<Id> (false);
+      }
+
+      /**
+         @brief Toggle the Led state, the identifier is checked at compile time
       */
-      bool led (int id) const;
+      template <int Id> void toggleLed() noexcept {
+        setLed<Id> (!led<Id>());
+      }
+
+      /**
+         @brief Get the Led state, the identifier is checked at compile time
+      */
+      template <int Id> bool led() const noexcept {
+        static_assert (Id >= 0 && Id < NofLeds, "Led identifier out of range");
+        return m_led[Id];
+      }
 
       /**
          @brief Set the display value which is send by the next poll() call
 
-         @param value Display value, range 0..999, if value is out of range an std::invalid_argument exception  is thrown
+         @param value Display value, range 0..999
+         @return StatusOk, StatusOutOfRange if value is out of range (the display value is not modified)
       */
-      void setDisplay (uint16_t value);
+      Status setDisplay (uint16_t value) noexcept;
 
       /**
          @brief Get the display value internally stored
 
          @return uint16_t Display value, range 0..999
       */
-      uint16_t display() const;
+      uint16_t display() const noexcept;
 
       /**
          @brief Enable/disable the display
@@ -127,35 +178,44 @@ namespace SpaIotSimulator {
 
          @param state true to enable the display, false to disable it
       */
-      void enableDisplay (bool state = true);
+      void enableDisplay (bool state = true) noexcept;
 
       /**
          @brief Get the display value internally stored
 
          @return bool state of the display, true if enabled, false otherwise
       */
-      bool isDisplayEnabled() const;
+      bool isDisplayEnabled() const noexcept;
 
       /**
          @brief Get the Button state internally stored
 
          @param id Button identifier, see ButtonId enum
+         @return the Button state, false if id is out of range
       */
-      bool button (int id) const;
+      bool button (int id) const noexcept;
+
+      /**
+         @brief Get the Button state, the identifier is checked at compile time
+      */
+      template <int Id> bool button() const noexcept {
+        static_assert (Id >= 0 && Id < NofButtons, "Button identifier out of range");
+        return m_button[Id];
+      }
 
       /**
          @brief Set the Buzzer state which is send by the next poll() call
 
          @param state Buzzer state, true for on, false for off, default is true
       */
-      void setBuzzer (bool state = true);
+      void setBuzzer (bool state = true) noexcept;
 
       /**
          @brief Get the Buzzer state internally stored
 
          @return true Buzzer is on
       */
-      bool isBuzzing() const;
+      bool isBuzzing() const noexcept;
 
       /**
          @brief Set the temperature unit to Celcius or Fahrenheit
@@ -165,14 +225,14 @@ namespace SpaIotSimulator {
 
          @param state true for Celcius, false for Fahrenheit
       */
-      void setCelcius (bool state = true);
+      void setCelcius (bool state = true) noexcept;
 
       /**
          @brief Get the temperature unit
 
          @return true Celcius, false Fahrenheit
       */
-      bool isCelcius() const;
+      bool isCelcius() const noexcept;
 
       /**
          @brief Convert Celcius to Fahrenheit
@@ -180,7 +240,7 @@ namespace SpaIotSimulator {
          @param c Celcius temperature
          @return int Fahrenheit temperature
       */
-      static int celciusToFahrenheit (double f);
+      static int celciusToFahrenheit (double f) noexcept;
 
       /**
          @brief Convert Fahrenheit to Celcius
@@ -188,7 +248,20 @@ namespace SpaIotSimulator {
          @param f Fahrenheit temperature
          @return int Celcius temperature
       */
-      static int fahrenheitToCelcius (double c);
+      static int fahrenheitToCelcius (double c) noexcept;
+
+      /**
+         @brief Measure the bus timing on the running board
+
+         Calls Bus::calibrate() with an idle frame, the result can be applied with bus().setTiming().
+         @return the timing profile
+      */
+      BusTiming calibrate();
+
+      /**
+         @brief Get the bus used by the engine
+      */
+      Bus &bus() noexcept;
 
     protected:
       enum DisplayId {
@@ -198,9 +271,9 @@ namespace SpaIotSimulator {
         DisplayFc,
         NofDisplays
       };
-      uint16_t ledFrame (uint16_t idleFrame);
-      uint16_t displayFrame (uint16_t idleFrame, int id);
-      int scanButtons (uint16_t idleFrame);
+      uint16_t ledFrame (uint16_t idleFrame) noexcept;
+      uint16_t displayFrame (uint16_t idleFrame, int id) noexcept;
+      int scanButtons (uint16_t idleFrame) noexcept;
 
     private:
       uint16_t m_display;
@@ -209,6 +282,7 @@ namespace SpaIotSimulator {
       bool m_celcius;
       std::array<bool, NofLeds> m_led;
       std::array<bool, NofButtons> m_button;
-      Bus m_bus;
+      std::unique_ptr<Bus> m_busOwner; // bus created by the pins constructor
+      Bus &m_bus;
   };
 }
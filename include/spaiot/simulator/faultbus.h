@@ -0,0 +1,186 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+#include "bus.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @brief Fault kinds injected by FaultBus
+  */
+  enum FaultKind {
+    FaultNone = 0,
+    FaultBitFlip,     ///< a bit of the frame is inverted, param: bit number
+    FaultDrop,        ///< the frame is not sent, the bus stays idle for a frame time
+    FaultDuplicate,   ///< the frame is sent twice
+    FaultExtraClock,  ///< a clock glitch duplicates a bit, param: bit number
+    FaultMissedClock, ///< a clock pulse is lost, param: bit number
+    FaultStretch,     ///< the freeze is longer, param: percentage of the freeze delay
+    FaultShorten,     ///< the freeze is shorter, param: percentage of the freeze delay
+    FaultStuckButton, ///< a button line is stuck for the whole cycle, param: ButtonId | (pressed << 8)
+    NofFaultKinds
+  };
+
+  /**
+     @brief Injected or scripted fault
+
+     index is the frame number in the poll() cycle for the frame faults,
+     the freeze number for FaultStretch and FaultShorten, unused for FaultStuckButton.
+  */
+  struct Fault {
+    uint32_t cycle;
+    uint16_t index;
+    uint16_t kind;
+    uint16_t param;
+  };
+
+  /**
+     @class FaultBus
+     @brief Fault injection around another bus
+
+     The frames, freezes and button reads are forwarded to the bus provided,
+     with faults injected by probabilistic rules (setRate()) or scripted ones (addFault()).
+
+     The faults of a poll() cycle are decided in beginCycle(), from a xorshift PRNG
+     seeded by the constructor, and stored in a plan indexed by frame and freeze number.
+     transfer() and freeze() only read the plan, so the timing of the clean frames
+     does not depend on the rules. Every injected fault is recorded in a buffer allocated
+     by the constructor, the record can be saved and replayed with loadScript() to
+     reproduce a failure exactly. The application should call flushRecord() regularly
+     outside poll(), so the faults are on disk if it is killed and the buffer does not fill up:
+     while the record is full, no fault is injected.
+
+     The clock faults are applied to the frame as the receiver latches it, assuming
+     the first bit sent is shifted the furthest, the frame still has 16 clock periods.
+  */
+  class FaultBus : public Bus {
+    public:
+      /**
+         @brief Constructor
+
+         No fault is injected until setRate() or addFault() is called.
+
+         @param bus bus which transfers the frames, must outlive this object
+         @param seed PRNG seed
+         @param recordSize maximum number of faults recorded, the record is allocated by the constructor
+      */
+      FaultBus (Bus &bus, uint64_t seed, size_t recordSize = 65536);
+
+      /**
+         @brief Set the probability of a fault kind
+
+         The probability applies to each frame for the frame faults, to each freeze
+         for FaultStretch and FaultShorten, to each cycle for FaultStuckButton.
+         @param kind fault kind
+         @param ppm probability in parts per million
+      */
+      void setRate (FaultKind kind, uint32_t ppm);
+
+      /**
+         @brief Set the probability of all the fault kinds
+      */
+      void setRate (uint32_t ppm);
+
+      /**
+         @brief Add a scripted fault
+
+         The faults must be added in cycle order.
+      */
+      void addFault (const Fault &fault);
+
+      /**
+         @brief Add the faults saved by saveRecord() as scripted faults
+
+         @return true if the file has been read
+      */
+      bool loadScript (const std::string &path);
+
+      /**
+         @brief Save the faults injected
+
+         @return true if the file has been written
+      */
+      bool saveRecord (const std::string &path) const;
+
+      /**
+         @brief Append the faults recorded to a file and empty the record
+
+         The file format is the one of saveRecord().
+         @return true if the file has been written, the record is kept otherwise
+      */
+      bool flushRecord (const std::string &path);
+
+      /**
+         @brief Faults injected since the construction or the last flushRecord(), in injection order
+      */
+      const std::vector<Fault> &record() const;
+
+      /**
+         @brief Check if the record is full, no fault is injected until it is flushed
+      */
+      bool isRecordFull() const;
+
+      /**
+         @brief Number of faults injected since the construction
+      */
+      unsigned long injected() const;
+
+      /**
+         @brief Set the time the bus stays idle for a dropped frame
+
+         Default is the frame time of the bus timing, 160 µs if not calibrated.
+      */
+      void setFrameTime (uint16_t us);
+
+      /**
+         @brief Name of a fault kind
+      */
+      static const char *kindName (int kind);
+
+      virtual Status begin() noexcept;
+      virtual void beginCycle() noexcept;
+      virtual void transfer (uint16_t data) noexcept;
+      virtual void freeze (uint16_t us) noexcept;
+      virtual void flush() noexcept;
+      virtual bool dataInPin() noexcept;
+      virtual BusTiming calibrate (uint16_t frame);
+      virtual void setTiming (const BusTiming &timing) noexcept;
+      virtual const BusTiming &timing() const noexcept;
+      virtual int lastError() const noexcept;
+      virtual void clearError() noexcept;
+
+      /**
+         @brief Maximum number of frames and freezes of a cycle with faults
+      */
+      static const int MaxEvents = 64;
+
+    protected:
+      struct Action {
+        uint16_t kind;
+        uint16_t param;
+      };
+      uint32_t random() noexcept;
+      void plan (const Fault &fault) noexcept;
+      void inject (Action &action, int index) noexcept;
+      void write (std::ostream &out) const;
+
+    private:
+      Bus &m_bus;
+      uint64_t m_state;
+      uint32_t m_cycle;
+      uint16_t m_frameTime;
+      std::array<uint32_t, NofFaultKinds> m_rate;
+      std::vector<Fault> m_script;
+      size_t m_nextScript;
+      std::vector<Fault> m_record;
+      unsigned long m_flushed;
+      std::array < Action, MaxEvents + 1 > m_frame;
+      std::array < Action, MaxEvents + 1 > m_freeze;
+      int m_frameIndex;
+      int m_freezeIndex;
+      uint16_t m_stuckFlag;
+      bool m_stuckLevel;
+      uint16_t m_lastFrame;
+  };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include "bus.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @class LoopbackBus
+     @brief Host-side stand-in of the spa bus
+
+     No pin is driven, the frames are recorded and the time is virtual:
+     each frame advances the time by the frame time of the bus timing, each
+     freeze by its delay, nothing waits. The button states are set by the
+     application and read back by the engine scan as if they were wired to the
+     data in pin. This allows to run the engine on a machine without GPIO.
+
+     Each frame is recorded as a 32-bit word, the frame in the low 16 bits
+     and the freeze that follows it in microseconds in the high 16 bits.
+     The record is cleared by beginCycle(), so it holds the frames of the last poll() cycle.
+  */
+  class LoopbackBus : public Bus {
+    public:
+      /**
+         @brief Constructor
+
+         All the buttons are released.
+      */
+      LoopbackBus();
+
+      /**
+         @brief Set a button state read back by the next poll()
+
+         @param id Button identifier, see ButtonId enum
+         @param pressed true for pressed
+      */
+      void setButton (int id, bool pressed = true) noexcept;
+
+      /**
+         @brief Frames of the current poll() cycle
+      */
+      const std::vector<uint32_t> &frames() const noexcept;
+
+      /**
+         @brief Virtual time since the construction in microseconds
+      */
+      uint64_t time() const noexcept;
+
+      virtual Status begin() noexcept;
+      virtual void beginCycle() noexcept;
+      virtual void transfer (uint16_t data) noexcept;
+      virtual void freeze (uint16_t us) noexcept;
+      virtual bool dataInPin() noexcept;
+      virtual BusTiming calibrate (uint16_t frame);
+
+      /**
+         @brief Capacity of the record, more frames than that in a cycle are ignored
+      */
+      static const int MaxFrames = 256;
+
+    private:
+      std::vector<uint32_t> m_frames;
+      uint64_t m_time;
+      uint16_t m_pressed;
+      uint16_t m_lastFrame;
+  };
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "loopbackbus.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @class Scenario
+     @brief Sequence of state changes applied to an engine on a LoopbackBus
+
+     A scenario is a text, one step per line, # starts a comment:
+     - led <led> <0|1>: setLed(), led is a LedId or power, filter, bubble, heatgreen, heatred
+     - display <0..999>: setDisplay()
+     - enable <0|1>: enableDisplay()
+     - buzzer <0|1>: setBuzzer()
+     - celcius <0|1>: setCelcius()
+     - button <button> <0|1>: button state read back by the next poll(), button is a ButtonId
+       or power, filter, bubble, heat, up, down, fc
+     - poll <count>: poll() count times
+     - expect led <led> <0|1>, expect display <0..999>, expect enable <0|1>,
+       expect buzzer <0|1>, expect celcius <0|1>: the run fails if the engine
+       state differs
+     .
+  */
+  class Scenario {
+    public:
+      enum Op {
+        OpLed = 0,
+        OpDisplay,
+        OpEnable,
+        OpBuzzer,
+        OpCelcius,
+        OpButton,
+        OpPoll,
+        OpExpectLed,
+        OpExpectDisplay,
+        OpExpectEnable,
+        OpExpectBuzzer,
+        OpExpectCelcius
+      };
+
+      struct Step {
+        int op;
+        int id;
+        int value;
+        int line;
+      };
+
+      /**
+         @brief Read a scenario file
+
+         @return true if the scenario has been read, false otherwise (see error())
+      */
+      bool load (const std::string &path);
+
+      /**
+         @brief Read a scenario text
+
+         The steps read are appended to the existing ones.
+         @return true if the scenario has been read, false otherwise (see error())
+      */
+      bool parse (std::istream &in);
+
+      /**
+         @brief Description of the last parse error
+      */
+      const std::string &error() const;
+
+      /**
+         @brief Steps of the scenario
+      */
+      const std::vector<Step> &steps() const;
+
+      /**
+         @brief Total number of poll() calls of the scenario
+      */
+      unsigned long polls() const;
+
+      /**
+         @brief Run the scenario
+
+         @param engine engine constructed with bus
+         @param bus bus of the engine
+         @param afterPoll called after each poll() with the button states returned,
+                the frames of the cycle are in bus.frames(), the run stops if it returns false
+         @param failure if not nullptr, receives the description of the expect step that failed
+         @return false if the run has been stopped by afterPoll or an expect step failed
+      */
+      bool run (Engine &engine, LoopbackBus &bus, const std::function<bool (int) > &afterPoll,
+                std::string *failure = nullptr) const;
+
+    protected:
+      bool addStep (const std::vector<std::string> &args, int line);
+
+    private:
+      std::vector<Step> m_steps;
+      std::string m_error;
+  };
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <ostream>
+#include "engine.h"
+#include "spamodel.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @class SpaDevice
+     @brief Behaviour of the spa device
+
+     Reacts to the buttons read by Engine::poll() as the spa does (power, filter,
+     bubble, heater, setpoint and temperature unit) and drives the leds and the
+     display from the thermal model. The time is given by the caller, so the
+     device runs in real time on the bus as well as in virtual time on a LoopbackBus.
+  */
+  class SpaDevice {
+    public:
+      /**
+         @brief Constructor
+
+         The water is at the temperature displayed by the engine, the setpoint is the model one.
+
+         @param engine engine driven, must outlive this object
+         @param log stream on which the button events are printed, nullptr for none
+      */
+      explicit SpaDevice (Engine &engine, std::ostream *log = nullptr);
+
+      /**
+         @brief Process the button states returned by Engine::poll() and update the model
+
+         setButton() is called for each button that changed since the last call, then step().
+         @param buttonStates button states returned by Engine::poll()
+         @param us elapsed time since the last call in microseconds
+      */
+      void update (int buttonStates, uint32_t us) noexcept;
+
+      /**
+         @brief Process a button event
+
+         @param id Button identifier, see ButtonId enum
+         @param state true for pressed, false for released
+      */
+      void setButton (int id, bool state) noexcept;
+
+      /**
+         @brief Update the water temperature, the heater leds and the display
+
+         @param us elapsed time since the last call in microseconds
+      */
+      void step (uint32_t us) noexcept;
+
+      /**
+         @brief Get the thermal model
+      */
+      SpaModel &model() noexcept;
+
+      /**
+         @brief Get the setpoint in the unit of the display
+      */
+      uint16_t setpoint() const noexcept;
+
+      /**
+         @brief Time the setpoint is displayed after Up/Down in microseconds
+      */
+      static const uint32_t SetpointShowTime = 3000000;
+
+      /**
+         @brief Setpoint range in °C, the limits are converted to the unit of the display
+      */
+      static const int SetpointMin = 10;
+      static const int SetpointMax = 40;
+
+    protected:
+      void showSetpoint() noexcept;
+      int setpointLimit (int celcius) const noexcept;
+
+    private:
+      Engine &m_engine;
+      SpaModel m_model;
+      std::ostream *m_log;
+      uint16_t m_tempValue;
+      uint32_t m_setpointShown; // remaining time the setpoint is displayed
+      int m_previousButtons;
+  };
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+
+namespace SpaIotSimulator {
+
+  /**
+     @class SpaModel
+     @brief Thermal model of the spa water
+
+     The water temperature evolves from the heater, filter and bubble states,
+     the loss to the ambient air and the setpoint:
+     - the heater heats while the water is below the setpoint, it stops when the setpoint is reached and
+       restarts when the water is 1°C below the setpoint,
+     - the filter pump adds a little heat,
+     - the loss is proportional to the difference with the ambient temperature, the bubbles increase it.
+     .
+
+     The temperature is a Q31.32 fixed point value in °C, step() only uses integer arithmetic
+     and runs in constant time, so it can be called once per poll() cycle.
+  */
+  class SpaModel {
+    public:
+      /**
+         @brief Constructor
+
+         Heater, filter and bubble off, setpoint 38°C.
+
+         @param ambient Ambient temperature in °C
+         @param water Initial water temperature in °C
+      */
+      SpaModel (int ambient = 20, int water = 20);
+
+      /**
+         @brief Evolve the water temperature
+
+         @param us elapsed time since the last call in microseconds
+      */
+      void step (uint32_t us) noexcept;
+
+      /**
+         @brief Batch run, evolve the water temperature by steps of one second
+
+         The inputs are not modified during the run, a day is simulated in a few milliseconds.
+         @param seconds simulated time
+      */
+      void run (uint32_t seconds) noexcept;
+
+      /**
+         @brief Get the water temperature rounded to the nearest degree
+
+         @param celcius true for Celcius, false for Fahrenheit
+      */
+      int temperature (bool celcius = true) const noexcept;
+
+      /**
+         @brief Get the water temperature in °C, Q31.32 fixed point
+      */
+      int64_t rawTemperature() const noexcept;
+
+      /**
+         @brief Set the water temperature in °C
+      */
+      void setTemperature (int celcius) noexcept;
+
+      /**
+         @brief Set the ambient temperature in °C
+      */
+      void setAmbient (int celcius) noexcept;
+
+      /**
+         @brief Set the setpoint in °C
+      */
+      void setSetpoint (int celcius) noexcept;
+
+      /**
+         @brief Get the setpoint in °C
+      */
+      int setpoint() const noexcept;
+
+      /**
+         @brief Enable or disable the heater
+      */
+      void setHeater (bool state = true) noexcept;
+
+      /**
+         @brief Get the heater state, true if enabled
+      */
+      bool isHeaterOn() const noexcept;
+
+      /**
+         @brief Get the heating state
+
+         @return true if the heater is enabled and is heating (setpoint not reached)
+      */
+      bool isHeating() const noexcept;
+
+      /**
+         @brief Set the filter pump state
+      */
+      void setFilter (bool state = true) noexcept;
+
+      /**
+         @brief Set the bubble blower state
+      */
+      void setBubble (bool state = true) noexcept;
+
+    private:
+      int64_t m_water;
+      int64_t m_ambient;
+      int64_t m_setpoint;
+      bool m_heater;
+      bool m_heating;
+      bool m_filter;
+      bool m_bubble;
+  };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <string>
+#include <linux/spi/spidev.h>
+#include "bus.h"
+
+namespace SpaIotSimulator {
+
+  /**
+     @class SpiIo
+     @brief System calls used by SpiBus
+
+     The default implementation calls the open(), ioctl() and close() functions
+     of the system. Derive this class to check the batches sent by SpiBus on a
+     machine without SPI hardware.
+  */
+  class SpiIo {
+    public:
+      virtual ~SpiIo();
+
+      /**
+         @brief Open the spidev device
+
+         @param path device path, eg /dev/spidev0.0
+         @return file descriptor, -1 on error (errno is set)
+      */
+      virtual int open (const char *path);
+
+      /**
+         @brief Send a request to the spidev device
+
+         @return -1 on error (errno is set)
+      */
+      virtual int ioctl (int fd, unsigned long request, void *arg);
+
+      /**
+         @brief Close the spidev device
+      */
+      virtual int close (int fd);
+  };
+
+  /**
+     @class SpiBus
+     @brief Spa bus on the hardware SPI controller
+
+     The frames are shifted out by the SPI controller (spidev) instead of being bit-banged:
+     - SDataOut is MOSI, SClk is SCLK (mode 3, clock idle high, data sampled on the rising edge),
+     - nWR is the chip select, low during each frame,
+     - SDataIn is still read on a GPIO pin.
+     .
+
+     The frames are queued and sent as one SPI_IOC_MESSAGE batch, with chip select
+     released between frames (cs_change). The queue is sent when it is full, when
+     flush() is called, before reading the data in pin and, by default, before each freeze:
+     the spidev core waits the delay_usecs of a transfer before releasing chip select,
+     so the freeze is waited once the message is sent, with nWR high as on the GPIO backend.
+
+     setQueueFreezes() queues the freezes as the delay_usecs of the last queued
+     frame instead, a whole display cycle of poll() is then sent by a single ioctl,
+     but nWR stays low during each freeze and only goes high for the short
+     chip select gap before the next frame. Use it only with a panel that accepts this timing.
+  */
+  class SpiBus : public Bus {
+    public:
+      /**
+         @brief Constructor
+
+         No hardware configuration is set (call begin() to set the hardware configuration)
+
+         @param device spidev device path, eg /dev/spidev0.0
+         @param dataInPin Data input pin number, this pin permit to read buttons states, -1 if not wired (no button pressed)
+         @param speedHz SPI clock frequency, 100 kHz is the clock period of the GPIO backend
+         @param io System calls used to access the device, nullptr for the system ones
+      */
+      SpiBus (const std::string &device, int dataInPin, uint32_t speedHz = 100000, SpiIo *io = nullptr);
+
+      /**
+         @brief Destructor, close the device
+      */
+      virtual ~SpiBus();
+
+      /**
+         @brief Open and configure the spidev device and the data in pin
+
+         The device is closed first if it is already open, and closed again if it can not be configured.
+         @return StatusOk, StatusIoError if the device can not be opened or configured (see lastError())
+      */
+      virtual Status begin() noexcept;
+
+      /**
+         @brief Queue a frame
+
+         @param data The frame to transfer, LSB first
+      */
+      virtual void transfer (uint16_t data) noexcept;
+
+      /**
+         @brief Freeze the bus after the last frame
+
+         The queued frames are sent and the delay is waited with nWR high,
+         or the delay is added to the last queued frame if setQueueFreezes() is enabled.
+         @param us Delay in microseconds
+      */
+      virtual void freeze (uint16_t us) noexcept;
+
+      /**
+         @brief Queue the freezes in the SPI batch
+
+         Disabled by default, see the class description.
+         @param queue true to send the freezes as the delay_usecs of the queued frames
+      */
+      void setQueueFreezes (bool queue) noexcept;
+
+      /**
+         @brief Send the queued frames as one SPI_IOC_MESSAGE
+
+         If the ioctl fails, the frames are lost, lastError() returns the errno value
+         and Engine::poll() returns -1.
+      */
+      virtual void flush() noexcept;
+
+      /**
+         @brief Send the queued frames and read the data in pin state
+
+         @return true if the data in pin is high
+      */
+      virtual bool dataInPin() noexcept;
+
+      /**
+         @brief Measure the frame time
+
+         The SPI controller does the bit timing, only frameNs is measured
+         (one frame sent by its own ioctl).
+         @param frame frame transferred to measure the frame time, should be an idle frame
+         @return the timing profile
+      */
+      virtual BusTiming calibrate (uint16_t frame);
+
+      /**
+         @brief Maximum number of frames sent by one ioctl
+      */
+      static const int MaxBatch = 64;
+
+    private:
+      std::string m_device;
+      uint32_t m_speed;
+      SpiIo *m_io;
+      int m_fd;
+      int m_count;
+      bool m_queueFreezes;
+      std::array<struct spi_ioc_transfer, MaxBatch> m_xfer;
+      std::array<uint8_t, MaxBatch * 2> m_tx;
+  };
+}
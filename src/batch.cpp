@@ -0,0 +1,105 @@
+// Parallel batch scenario runner
+//
+// Runs button scripts against the engine and the spa device logic on the
+// LoopbackBus, one scenario per task on a work-stealing pool of threads,
+// and reports the result of each scenario in the order of the command line.
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <spaiot-simulator.h>
+
+using namespace SpaIotSimulator;
+
+int main (int argc, char *argv[]) {
+  std::vector<std::string> paths;
+  unsigned threads = 0;
+  bool quiet = false;
+  int opt;
+
+  while ( (opt = getopt (argc, argv, "j:l:q")) != -1) {
+
+    switch (opt) {
+      case 'j':
+        threads = strtoul (optarg, nullptr, 10);
+        break;
+      case 'l': {
+        std::ifstream list (optarg);
+        std::string path;
+
+        if (!list) {
+
+          std::cerr << "Unable to open " << optarg << std::endl;
+          exit (EXIT_FAILURE);
+        }
+        while (std::getline (list, path)) {
+
+          if (!path.empty()) {
+
+            paths.push_back (path);
+          }
+        }
+      }
+      break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        break;
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+
+    paths.push_back (argv[i]);
+  }
+
+  if (paths.empty()) {
+
+    std::cerr << "Usage: " << argv[0] << " [-j threads] [-q] [-l listFile] scenarioFile..." << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  std::vector<Scenario> scenarios (paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+
+    if (!scenarios[i].load (paths[i])) {
+
+      std::cerr << paths[i] << ": " << scenarios[i].error() << std::endl;
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  BatchRunner runner (threads);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<BatchResult> results = runner.run (scenarios);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  size_t failed = 0;
+  unsigned long polls = 0;
+
+  std::cout << std::fixed << std::setprecision (1);
+  for (size_t i = 0; i < results.size(); i++) {
+    const BatchResult &r = results[i];
+
+    polls += r.polls;
+    if (!r.passed) {
+
+      failed++;
+    }
+    if (!quiet || !r.passed) {
+
+      std::cout << (r.passed ? "PASS " : "FAIL ") << paths[i] << ": " << r.polls << " polls, "
+                << r.virtualTime / 1000000.0 << " s simulated in " << r.wallTime << " ms";
+      if (!r.passed) {
+
+        std::cout << ", " << r.failure;
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  std::cout << results.size() - failed << " passed, " << failed << " failed, "
+            << polls << " polls on " << runner.threads() << " threads in " << elapsed.count() << " ms" << std::endl;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
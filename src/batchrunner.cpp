@@ -0,0 +1,138 @@
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <spaiot/simulator/batchrunner.h>
+#include <spaiot/simulator/spadevice.h>
+
+namespace SpaIotSimulator {
+
+  namespace {
+
+    // Scenario indexes of a worker, the owner pops at the back, thieves steal at the front
+    class WorkQueue {
+      public:
+        void push (size_t index) {
+          std::lock_guard<std::mutex> lock (m_mutex);
+
+          m_queue.push_back (index);
+        }
+
+        bool pop (size_t &index) {
+          std::lock_guard<std::mutex> lock (m_mutex);
+
+          if (m_queue.empty()) {
+
+            return false;
+          }
+          index = m_queue.back();
+          m_queue.pop_back();
+          return true;
+        }
+
+        bool steal (size_t &index) {
+          std::lock_guard<std::mutex> lock (m_mutex);
+
+          if (m_queue.empty()) {
+
+            return false;
+          }
+          index = m_queue.front();
+          m_queue.pop_front();
+          return true;
+        }
+
+      private:
+        std::mutex m_mutex;
+        std::deque<size_t> m_queue;
+    };
+  }
+
+  //----------------------------------------------------------------------------
+  BatchRunner::BatchRunner (unsigned threads) :
+    m_threads (threads ? threads : std::thread::hardware_concurrency()) {
+
+    if (m_threads == 0) {
+
+      m_threads = 1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned BatchRunner::threads() const {
+
+    return m_threads;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<BatchResult> BatchRunner::run (const std::vector<Scenario> &scenarios) const {
+    std::vector<BatchResult> results (scenarios.size());
+    size_t n = std::min<size_t> (m_threads, scenarios.size());
+    std::vector<WorkQueue> queues (n);
+    std::vector<std::thread> workers;
+
+    if (n == 0) {
+
+      return results;
+    }
+
+    // contiguous blocks, the neighbour scenarios often have the same length
+    for (size_t i = 0; i < scenarios.size(); i++) {
+
+      queues[i * n / scenarios.size()].push (i);
+    }
+
+    for (size_t w = 0; w < n; w++) {
+
+      workers.push_back (std::thread ([&, w]() {
+        size_t index;
+
+        for (;;) {
+          bool found = queues[w].pop (index);
+
+          // no scenario is added once started, all the queues empty means done
+          for (size_t v = 1; !found && v < n; v++) {
+
+            found = queues[ (w + v) % n].steal (index);
+          }
+          if (!found) {
+
+            break;
+          }
+          results[index] = runOne (scenarios[index]);
+        }
+      }));
+    }
+
+    for (std::thread &t : workers) {
+
+      t.join();
+    }
+    return results;
+  }
+
+  //----------------------------------------------------------------------------
+  // static
+  BatchResult BatchRunner::runOne (const Scenario &scenario) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BatchResult result;
+    LoopbackBus bus;
+    Engine engine (bus);
+    SpaDevice spa (engine);
+    uint64_t last = 0;
+
+    result.polls = 0;
+    engine.begin();
+    result.passed = scenario.run (engine, bus, [&] (int buttons) {
+
+      spa.update (buttons, bus.time() - last);
+      last = bus.time();
+      result.polls++;
+      return true;
+    }, &result.failure);
+
+    result.virtualTime = bus.time();
+    result.wallTime = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count();
+    return result;
+  }
+}
@@ -1,46 +1,266 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <time.h>
 #include <Arduino.h>
 #include <spaiot/simulator/bus.h>
 
 namespace SpaIotSimulator {
 
+  // Spec minimums of the half clock periods in nanoseconds
+  const uint32_t ClkLowMin = 5000;
+  const uint32_t DataSetupMin = 2000;
+  const uint32_t ClkHighMin = 3000;
+
+  //----------------------------------------------------------------------------
+  //
+  //                            BusTiming Struct
+  //
+  //----------------------------------------------------------------------------
+
+  //----------------------------------------------------------------------------
+  BusTiming::BusTiming() :
+    clkLow (ClkLowMin / 1000),
+    dataSetup (DataSetupMin / 1000),
+    clkHigh (ClkHighMin / 1000),
+    writeNs (0),
+    delayNs (0),
+    frameNs (0) {
+
+  }
+
+  //----------------------------------------------------------------------------
+  bool BusTiming::load (const std::string &path, const std::string &platform) {
+    std::ifstream f (path);
+    std::string measured;
+    BusTiming t;
+
+    if (std::getline (f, measured) && measured == platform &&
+        f >> t.clkLow >> t.dataSetup >> t.clkHigh >> t.writeNs >> t.delayNs >> t.frameNs &&
+        t.isValid()) {
+
+      *this = t;
+      return true;
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  bool BusTiming::save (const std::string &path, const std::string &platform) const {
+    std::ofstream f (path);
+
+    f << platform << std::endl;
+    f << clkLow << ' ' << dataSetup << ' ' << clkHigh << std::endl;
+    f << writeNs << ' ' << delayNs << ' ' << frameNs << std::endl;
+    return f.good();
+  }
+
+  //----------------------------------------------------------------------------
+  bool BusTiming::isValid() const noexcept {
+    const uint16_t delay[] = { clkLow, dataSetup, clkHigh };
+    const uint32_t min[] = { ClkLowMin, DataSetupMin, ClkHighMin };
+
+    for (int i = 0; i < 3; i++) {
+      uint32_t half = writeNs + (delay[i] ? delay[i] * 1000 + delayNs : 0);
+
+      if (half < min[i]) {
+
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //
+  //                            Bus Class
+  //
+  //----------------------------------------------------------------------------
 
   //----------------------------------------------------------------------------
   Bus::Bus (int clkPin, int dataOutPin, int nWrPin, int dataInPin) :
-    m_pin {clkPin, dataOutPin, nWrPin, dataInPin} {
+    m_pin {clkPin, dataOutPin, nWrPin, dataInPin},
+    m_error (0) {
+
+  }
+
+  //----------------------------------------------------------------------------
+  Bus::~Bus() {
 
   }
 
   //----------------------------------------------------------------------------
-  void Bus::begin() {
+  Status Bus::begin() noexcept {
+
+    // pins < 0 are driven by another backend (see SpiBus) or not wired
+    for (int i = 0; i < SDataIn; i++) {
 
-    for (int i = 0; i < (m_pin.size() - 1); i++) {
+      if (m_pin[i] >= 0) {
 
-      pinMode (m_pin[i], OUTPUT);
-      digitalWrite (m_pin[i], HIGH);
+        pinMode (m_pin[i], OUTPUT);
+        digitalWrite (m_pin[i], HIGH);
+      }
     }
-    pinMode (m_pin[SDataIn], INPUT);
+    if (m_pin[SDataIn] >= 0) {
+
+      pinMode (m_pin[SDataIn], INPUT);
+    }
+    return StatusOk;
   }
 
   //----------------------------------------------------------------------------
-  void Bus::transfer (uint16_t data) {
+  void Bus::beginCycle() noexcept {
+
+  }
+
+  //----------------------------------------------------------------------------
+  void Bus::transfer (uint16_t data) noexcept {
     uint16_t mask = 1;
 
     digitalWrite (m_pin[nWR], LOW);
 
     while (mask) {
       digitalWrite (m_pin[SClk], LOW);
-      delayMicroseconds (5);
+      if (m_timing.clkLow) {
+        delayMicroseconds (m_timing.clkLow);
+      }
       digitalWrite (m_pin[SDataOut], (mask & data) != 0);
-      delayMicroseconds (2);
+      if (m_timing.dataSetup) {
+        delayMicroseconds (m_timing.dataSetup);
+      }
       digitalWrite (m_pin[SClk], HIGH);
-      delayMicroseconds (3);
+      if (m_timing.clkHigh) {
+        delayMicroseconds (m_timing.clkHigh);
+      }
       mask <<= 1;
     }
     digitalWrite (m_pin[nWR], HIGH);
   }
 
   //----------------------------------------------------------------------------
-  bool Bus::dataInPin() {
-    return digitalRead (m_pin[SDataIn]) != LOW;
+  void Bus::freeze (uint16_t us) noexcept {
+
+    delayMicroseconds (us);
+  }
+
+  //----------------------------------------------------------------------------
+  void Bus::flush() noexcept {
+
+  }
+
+  //----------------------------------------------------------------------------
+  bool Bus::dataInPin() noexcept {
+
+    // no pin wired, no button pressed
+    return m_pin[SDataIn] < 0 || digitalRead (m_pin[SDataIn]) != LOW;
+  }
+
+  //----------------------------------------------------------------------------
+  BusTiming Bus::calibrate (uint16_t frame) {
+    const int n = 1000;
+    BusTiming t;
+    BusTiming current = m_timing;
+    uint64_t best;
+
+    // pin write, SDataOut is not sampled while nWR is high
+    best = UINT64_MAX;
+    for (int r = 0; r < CalibrationRuns; r++) {
+      uint64_t start = nanos();
+
+      for (int i = 0; i < n; i++) {
+
+        digitalWrite (m_pin[SDataOut], i & 1);
+      }
+      best = std::min (best, nanos() - start);
+    }
+    digitalWrite (m_pin[SDataOut], HIGH);
+    t.writeNs = best / n;
+
+    // delay call overhead
+    best = UINT64_MAX;
+    for (int r = 0; r < CalibrationRuns; r++) {
+      uint64_t start = nanos();
+
+      for (int i = 0; i < n / 10; i++) {
+
+        delayMicroseconds (1);
+      }
+      best = std::min (best, nanos() - start);
+    }
+    best /= n / 10;
+    t.delayNs = best > 1000 ? best - 1000 : 0;
+
+    // shortest delays such as pin write + delay >= spec minimum
+    struct {
+      uint16_t &delay;
+      uint32_t min;
+    } half[] = {{t.clkLow, ClkLowMin}, {t.dataSetup, DataSetupMin}, {t.clkHigh, ClkHighMin}};
+
+    for (auto &h : half) {
+
+      if (t.writeNs >= h.min) {
+
+        h.delay = 0;
+      }
+      else {
+        uint32_t left = h.min - t.writeNs;
+
+        left = left > t.delayNs ? left - t.delayNs : 0;
+        h.delay = std::max<uint32_t> (1, (left + 999) / 1000);
+      }
+    }
+
+    // frame time achieved
+    m_timing = t;
+    best = UINT64_MAX;
+    for (int r = 0; r < CalibrationRuns; r++) {
+      uint64_t start = nanos();
+
+      transfer (frame);
+      best = std::min (best, nanos() - start);
+    }
+    m_timing = current;
+    t.frameNs = best;
+    return t;
+  }
+
+  //----------------------------------------------------------------------------
+  void Bus::setTiming (const BusTiming &timing) noexcept {
+
+    m_timing = timing;
+  }
+
+  //----------------------------------------------------------------------------
+  const BusTiming &Bus::timing() const noexcept {
+
+    return m_timing;
+  }
+
+  //----------------------------------------------------------------------------
+  int Bus::lastError() const noexcept {
+
+    return m_error;
+  }
+
+  //----------------------------------------------------------------------------
+  void Bus::clearError() noexcept {
+
+    m_error = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  void Bus::setError (int error) noexcept {
+
+    m_error = error;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected static
+  uint64_t Bus::nanos() {
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t> (ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
   }
 }
@@ -1,24 +1,8 @@
-#include <exception>
 #include <cmath>
-#include <Arduino.h>
 #include "engine_p.h"
 
 namespace SpaIotSimulator {
 
-  const uint16_t FreezeTime = 260;
-  const uint16_t DigitFlag[] = {
-    Digit0,
-    Digit1,
-    Digit2,
-    Digit3,
-    Digit4,
-    Digit5,
-    Digit6,
-    Digit7,
-    Digit8,
-    Digit9
-  };
-
   //----------------------------------------------------------------------------
   //
   //                            Engine Class
@@ -31,92 +15,113 @@ namespace SpaIotSimulator {
     m_displayEn (true),
     m_buzzer (false),
     m_celcius (true),
-    m_bus (clkPin, dataOutPin, nWrPin, dataInPin) {
+    m_busOwner (new Bus (clkPin, dataOutPin, nWrPin, dataInPin)),
+    m_bus (*m_busOwner) {
+
+    m_led.fill (false);
+    m_button.fill (false);
+  }
+
+  //----------------------------------------------------------------------------
+  Engine::Engine (Bus &bus) :
+    m_display (20),
+    m_displayEn (true),
+    m_buzzer (false),
+    m_celcius (true),
+    m_bus (bus) {
 
     m_led.fill (false);
     m_button.fill (false);
   }
 
   //----------------------------------------------------------------------------
-  void Engine::begin() {
+  Status Engine::begin() noexcept {
 
-    m_bus.begin();
+    return m_bus.begin();
   }
 
   //----------------------------------------------------------------------------
-  int Engine::poll() {
+  int Engine::poll() noexcept {
     uint16_t idle = IdleFrame | (m_buzzer ? BUZ : 0);
 
+    m_bus.clearError();
+    m_bus.beginCycle();
     for (int it = 0; it < 5; it++) {
 
       // Leds
       m_bus.transfer (ledFrame (idle));
-      delayMicroseconds (FreezeTime);
+      m_bus.freeze (FreezeTime);
 
       for (int id = 0; id < NofDisplays; id++) {
 
         m_bus.transfer (idle);
         m_bus.transfer (displayFrame (idle, id));
-        delayMicroseconds (FreezeTime);
+        m_bus.freeze (FreezeTime);
       }
 
       m_bus.transfer (idle);
-      delayMicroseconds (FreezeTime);
+      m_bus.freeze (FreezeTime);
     }
 
-    return scanButtons (idle);
+    int buttons = scanButtons (idle);
+    return m_bus.lastError() ? -1 : buttons;
   }
 
   //----------------------------------------------------------------------------
-  bool Engine::led (int i) const {
+  bool Engine::led (int i) const noexcept {
 
-    return m_led.at (i);
+    return static_cast<unsigned> (i) < NofLeds ? m_led[i] : false;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::setLed (int i, bool state) {
+  Status Engine::setLed (int i, bool state) noexcept {
 
-    m_led.at (i) = state;
+    if (static_cast<unsigned> (i) >= NofLeds) {
+
+      return StatusBadId;
+    }
+    m_led[i] = state;
+    return StatusOk;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::clearLed (int i) {
+  Status Engine::clearLed (int i) noexcept {
 
-    setLed (i, false);
+    return setLed (i, false);
   }
 
   //----------------------------------------------------------------------------
-  void Engine::toggleLed (int i) {
+  Status Engine::toggleLed (int i) noexcept {
 
-    setLed (i, !led (i));
+    return setLed (i, !led (i));
   }
 
   //----------------------------------------------------------------------------
-  bool Engine::button (int i) const {
+  bool Engine::button (int i) const noexcept {
 
-    return m_button.at (i);
+    return static_cast<unsigned> (i) < NofButtons ? m_button[i] : false;
   }
 
   //----------------------------------------------------------------------------
-  bool Engine::isBuzzing() const {
+  bool Engine::isBuzzing() const noexcept {
 
     return m_buzzer;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::setBuzzer (bool state) {
+  void Engine::setBuzzer (bool state) noexcept {
 
     m_buzzer = state;
   }
 
   //----------------------------------------------------------------------------
-  bool Engine::isCelcius() const {
+  bool Engine::isCelcius() const noexcept {
 
     return m_celcius;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::setCelcius (bool state) {
+  void Engine::setCelcius (bool state) noexcept {
 
     if (state != m_celcius) {
 
@@ -127,48 +132,62 @@ namespace SpaIotSimulator {
   }
 
   //----------------------------------------------------------------------------
-  uint16_t Engine::display() const {
+  uint16_t Engine::display() const noexcept {
 
     return m_display;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::setDisplay (uint16_t value) {
+  Status Engine::setDisplay (uint16_t value) noexcept {
 
     if (value >= 1000) {
-      throw std::invalid_argument ("display value out of range");
+
+      return StatusOutOfRange;
     }
     m_display = value;
+    return StatusOk;
   }
 
   //----------------------------------------------------------------------------
-  bool Engine::isDisplayEnabled() const {
+  bool Engine::isDisplayEnabled() const noexcept {
 
     return m_displayEn;
   }
 
   //----------------------------------------------------------------------------
-  void Engine::enableDisplay (bool state) {
+  void Engine::enableDisplay (bool state) noexcept {
 
     m_displayEn = state;
   }
 
+  //----------------------------------------------------------------------------
+  BusTiming Engine::calibrate() {
+
+    return m_bus.calibrate (IdleFrame);
+  }
+
+  //----------------------------------------------------------------------------
+  Bus &Engine::bus() noexcept {
+
+    return m_bus;
+  }
+
   //------------------------------------------------------------------------------
   // static
-  int Engine::celciusToFahrenheit (double t) {
+  int Engine::celciusToFahrenheit (double t) noexcept {
 
     return std::lround ( (9 * t) / 5 + 32);
   }
 
   //------------------------------------------------------------------------------
   // static
-  int Engine::fahrenheitToCelcius (double t) {
+  int Engine::fahrenheitToCelcius (double t) noexcept {
 
     return std::lround ( ( (t - 32) * 5) / 9);
   }
   //----------------------------------------------------------------------------
   // protected
-  uint16_t Engine::ledFrame (uint16_t frame) {
+  uint16_t Engine::ledFrame (uint16_t frame) noexcept {
 
     for (int id = 0; id < NofLeds; id++) {
 
@@ -183,7 +202,7 @@ namespace SpaIotSimulator {
 
   //----------------------------------------------------------------------------
   // protected
-  uint16_t Engine::displayFrame (uint16_t frame, int id) {
+  uint16_t Engine::displayFrame (uint16_t frame, int id) noexcept {
 
     if (id == DisplayFc) {
 
@@ -211,7 +230,7 @@ namespace SpaIotSimulator {
 
   //----------------------------------------------------------------------------
   // protected
-  int Engine::scanButtons (uint16_t frame) {
+  int Engine::scanButtons (uint16_t frame) noexcept {
     int rc = 0;
     // Scan order flags
     // S1_FILTER, S7_HEAT, S5_UP, S4_DOWN, S2_BUBBLE, S3_POWER, S6_FC
@@ -224,7 +243,7 @@ namespace SpaIotSimulator {
       int i = buttonIndex[f];
 
       m_bus.transfer (frame & ~ButtonFlag[f]);
-      delayMicroseconds (5);
+      m_bus.freeze (5);
       m_button[i] = ! m_bus.dataInPin();
       rc |= m_button[i] ? 1 << i : 0;
     }
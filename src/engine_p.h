@@ -4,6 +4,11 @@
 
 namespace SpaIotSimulator {
 
+  // Bus idle time after the led and display frames in microseconds
+  const uint16_t FreezeTime = 260;
+  // Frame time of an uncalibrated bus in microseconds
+  const uint16_t DefaultFrameTime = 160;
+
   enum ShiftRegFlag {
     D4_POWER = 1 << 15,
     S1_FILTER = 1 << 14,
@@ -58,6 +63,19 @@ namespace SpaIotSimulator {
   const uint16_t DigitF =   D + C + G + B + DP;         // °F
   const uint16_t DigitC =   D + C + B + A + DP;         // °C
 
+  const uint16_t DigitFlag[] = {
+    Digit0,
+    Digit1,
+    Digit2,
+    Digit3,
+    Digit4,
+    Digit5,
+    Digit6,
+    Digit7,
+    Digit8,
+    Digit9
+  };
+
   const uint16_t LedFlag[] = { (uint16_t) D4_POWER, (uint16_t) D3_FILTER,
                                (uint16_t) D1_BUBBLE, (uint16_t) D2_HEAT_G,
                                (uint16_t) D2_HEAT_R
@@ -69,6 +87,13 @@ namespace SpaIotSimulator {
                                   (uint16_t) S6_FC
                                 };
 
+  // Button line tested by a scan frame, indexed by ButtonId
+  const uint16_t ButtonLine[NofButtons] = { (uint16_t) S3_POWER, (uint16_t) S1_FILTER,
+                                            (uint16_t) S2_BUBBLE, (uint16_t) S7_HEAT,
+                                            (uint16_t) S5_UP, (uint16_t) S4_DOWN,
+                                            (uint16_t) S6_FC
+                                          };
+
   const uint16_t DisplayFlag[] = { (uint16_t) DSP1_3, (uint16_t) DSP1_2,
                                    (uint16_t) DSP1_1, (uint16_t) DSP2
                                  };
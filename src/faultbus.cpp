@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <fstream>
+#include <spaiot/simulator/faultbus.h>
+#include "engine_p.h"
+
+namespace SpaIotSimulator {
+
+  const char *KindName[NofFaultKinds] = {
+    "none",
+    "bitflip",
+    "drop",
+    "duplicate",
+    "extraclock",
+    "missedclock",
+    "stretch",
+    "shorten",
+    "stuckbutton"
+  };
+
+  //----------------------------------------------------------------------------
+  FaultBus::FaultBus (Bus &bus, uint64_t seed, size_t recordSize) :
+    Bus (-1, -1, -1, -1),
+    m_bus (bus),
+    m_state (seed ? seed : 0x9E3779B97F4A7C15ULL),
+    m_cycle (0),
+    m_frameTime (DefaultFrameTime),
+    m_nextScript (0),
+    m_flushed (0),
+    m_frameIndex (0),
+    m_freezeIndex (0),
+    m_stuckFlag (0),
+    m_stuckLevel (true),
+    m_lastFrame (0xFFFF) {
+
+    m_rate.fill (0);
+    m_record.reserve (recordSize);
+    m_frame.fill (Action {FaultNone, 0});
+    m_freeze.fill (Action {FaultNone, 0});
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::setRate (FaultKind kind, uint32_t ppm) {
+
+    if (kind > FaultNone && kind < NofFaultKinds) {
+      uint64_t t = (static_cast<uint64_t> (ppm) << 32) / 1000000;
+
+      m_rate[kind] = std::min<uint64_t> (t, UINT32_MAX);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::setRate (uint32_t ppm) {
+
+    for (int kind = FaultNone + 1; kind < NofFaultKinds; kind++) {
+
+      setRate (static_cast<FaultKind> (kind), ppm);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::addFault (const Fault &fault) {
+
+    m_script.push_back (fault);
+  }
+
+  //----------------------------------------------------------------------------
+  bool FaultBus::loadScript (const std::string &path) {
+    std::ifstream f (path);
+    Fault fault;
+    std::string kind;
+
+    if (!f) {
+
+      return false;
+    }
+    while (f >> fault.cycle >> fault.index >> kind >> fault.param) {
+      const char **k = std::find_if (KindName, KindName + NofFaultKinds,
+      [&kind] (const char *n) { return kind == n; });
+
+      if (k == KindName + NofFaultKinds) {
+
+        return false;
+      }
+      fault.kind = k - KindName;
+      addFault (fault);
+    }
+    return f.eof();
+  }
+
+  //----------------------------------------------------------------------------
+  bool FaultBus::saveRecord (const std::string &path) const {
+    std::ofstream f (path);
+
+    write (f);
+    return f.good();
+  }
+
+  //----------------------------------------------------------------------------
+  bool FaultBus::flushRecord (const std::string &path) {
+    std::ofstream f (path, std::ios::app);
+
+    write (f);
+    f.close();
+    if (!f) {
+
+      return false;
+    }
+    m_flushed += m_record.size();
+    m_record.clear(); // the capacity is kept
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  const std::vector<Fault> &FaultBus::record() const {
+
+    return m_record;
+  }
+
+  //----------------------------------------------------------------------------
+  bool FaultBus::isRecordFull() const {
+
+    return m_record.size() == m_record.capacity();
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned long FaultBus::injected() const {
+
+    return m_flushed + m_record.size();
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::setFrameTime (uint16_t us) {
+
+    m_frameTime = us;
+  }
+
+  //----------------------------------------------------------------------------
+  // static
+  const char *FaultBus::kindName (int kind) {
+
+    return (kind >= 0 && kind < NofFaultKinds) ? KindName[kind] : "unknown";
+  }
+
+  //----------------------------------------------------------------------------
+  Status FaultBus::begin() noexcept {
+
+    return m_bus.begin();
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::beginCycle() noexcept {
+
+    m_frame.fill (Action {FaultNone, 0});
+    m_freeze.fill (Action {FaultNone, 0});
+    m_frameIndex = 0;
+    m_freezeIndex = 0;
+    m_stuckFlag = 0;
+
+    // scripted faults
+    while (m_nextScript < m_script.size() && m_script[m_nextScript].cycle <= m_cycle) {
+      const Fault &fault = m_script[m_nextScript++];
+
+      if (fault.cycle == m_cycle) {
+
+        plan (fault);
+      }
+    }
+
+    // probabilistic faults
+    for (int i = 0; i < MaxEvents; i++) {
+      uint64_t threshold = 0;
+      uint32_t r = random();
+
+      for (int kind = FaultBitFlip; kind <= FaultMissedClock; kind++) {
+
+        threshold += m_rate[kind];
+        if (r < threshold) {
+          uint16_t param = random() & 15;
+
+          plan (Fault {m_cycle, static_cast<uint16_t> (i), static_cast<uint16_t> (kind), param});
+          break;
+        }
+      }
+
+      r = random();
+      if (r < m_rate[FaultStretch]) {
+
+        plan (Fault {m_cycle, static_cast<uint16_t> (i), FaultStretch, static_cast<uint16_t> (125 + random() % 276)});
+      }
+      else if (r < static_cast<uint64_t> (m_rate[FaultStretch]) + m_rate[FaultShorten]) {
+
+        plan (Fault {m_cycle, static_cast<uint16_t> (i), FaultShorten, static_cast<uint16_t> (random() % 76)});
+      }
+    }
+
+    if (random() < m_rate[FaultStuckButton]) {
+      // drawn one after the other, the same faults for the same seed on any compiler
+      uint16_t button = random() % NofButtons;
+      uint16_t stuck = random() & 1;
+
+      plan (Fault {m_cycle, 0, FaultStuckButton, static_cast<uint16_t> (button | (stuck << 8))});
+    }
+
+    m_cycle++;
+    m_bus.beginCycle();
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::transfer (uint16_t data) noexcept {
+    Action &a = m_frame[m_frameIndex];
+    uint16_t low;
+
+    m_lastFrame = data;
+    if (a.kind != FaultNone) {
+
+      inject (a, m_frameIndex);
+    }
+    if (m_frameIndex < MaxEvents) {
+
+      m_frameIndex++;
+    }
+
+    switch (a.kind) {
+
+      case FaultBitFlip:
+        m_bus.transfer (data ^ (1 << a.param));
+        break;
+
+      case FaultDrop:
+        m_bus.freeze (m_frameTime);
+        break;
+
+      case FaultDuplicate:
+        m_bus.transfer (data);
+        m_bus.transfer (data);
+        break;
+
+      case FaultExtraClock:
+        // bit param sampled twice, the first bit is shifted out
+        low = (1 << a.param) - 1;
+        m_bus.transfer ( ( (data >> 1) & low) | (data & ~low));
+        break;
+
+      case FaultMissedClock:
+        // bit param never sampled, the first bit is the idle level
+        low = (2 << a.param) - 1;
+        m_bus.transfer ( ( ( (data << 1) | 1) & low) | (data & ~low));
+        break;
+
+      default:
+        m_bus.transfer (data);
+        break;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::freeze (uint16_t us) noexcept {
+    Action &a = m_freeze[m_freezeIndex];
+
+    if (a.kind != FaultNone) {
+
+      inject (a, m_freezeIndex);
+    }
+    if (m_freezeIndex < MaxEvents) {
+
+      m_freezeIndex++;
+    }
+
+    if (a.kind == FaultStretch || a.kind == FaultShorten) {
+      uint32_t d = (static_cast<uint32_t> (us) * a.param) / 100;
+
+      us = d > 0xFFFF ? 0xFFFF : d;
+    }
+    m_bus.freeze (us);
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::flush() noexcept {
+
+    m_bus.flush();
+  }
+
+  //----------------------------------------------------------------------------
+  bool FaultBus::dataInPin() noexcept {
+    bool level = m_bus.dataInPin();
+
+    if (m_stuckFlag && (m_lastFrame & m_stuckFlag) == 0) {
+
+      level = m_stuckLevel;
+    }
+    return level;
+  }
+
+  //----------------------------------------------------------------------------
+  BusTiming FaultBus::calibrate (uint16_t frame) {
+
+    return m_bus.calibrate (frame);
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::setTiming (const BusTiming &timing) noexcept {
+
+    m_bus.setTiming (timing);
+    if (timing.frameNs) {
+
+      m_frameTime = (timing.frameNs + 500) / 1000;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  const BusTiming &FaultBus::timing() const noexcept {
+
+    return m_bus.timing();
+  }
+
+  //----------------------------------------------------------------------------
+  int FaultBus::lastError() const noexcept {
+
+    return m_bus.lastError();
+  }
+
+  //----------------------------------------------------------------------------
+  void FaultBus::clearError() noexcept {
+
+    m_bus.clearError();
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  // xorshift64*
+  uint32_t FaultBus::random() noexcept {
+
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    return (m_state * 0x2545F4914F6CDD1DULL) >> 32;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  void FaultBus::plan (const Fault &fault) noexcept {
+
+    // a single fault per frame, freeze and cycle for the stuck buttons
+
+    switch (fault.kind) {
+
+      case FaultBitFlip:
+      case FaultDrop:
+      case FaultDuplicate:
+      case FaultExtraClock:
+      case FaultMissedClock:
+        if (fault.index >= MaxEvents || m_frame[fault.index].kind != FaultNone) {
+          return;
+        }
+        m_frame[fault.index] = Action {fault.kind, static_cast<uint16_t> (fault.param & 15)};
+        break;
+
+      case FaultStretch:
+      case FaultShorten:
+        if (fault.index >= MaxEvents || m_freeze[fault.index].kind != FaultNone) {
+          return;
+        }
+        m_freeze[fault.index] = Action {fault.kind, fault.param};
+        break;
+
+      case FaultStuckButton:
+        if ( (fault.param & 0xFF) >= NofButtons || m_stuckFlag) {
+          return;
+        }
+        if (m_record.size() == m_record.capacity()) {
+          return;
+        }
+        m_stuckFlag = ButtonLine[fault.param & 0xFF];
+        m_stuckLevel = (fault.param >> 8) == 0; // pressed pulls the line low
+        m_record.push_back (fault);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  // The frame and freeze faults are recorded when they are injected,
+  // the faults planned beyond the last frame of the cycle are not.
+  void FaultBus::inject (Action &action, int index) noexcept {
+
+    if (m_record.size() == m_record.capacity()) {
+
+      action.kind = FaultNone; // every injected fault must be recorded
+    }
+    else {
+
+      m_record.push_back (Fault {m_cycle - 1, static_cast<uint16_t> (index), action.kind, action.param});
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  void FaultBus::write (std::ostream &out) const {
+
+    for (const Fault &fault : m_record) {
+
+      out << fault.cycle << ' ' << fault.index << ' ' << kindName (fault.kind) << ' ' << fault.param << '\n';
+    }
+  }
+}
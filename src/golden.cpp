@@ -0,0 +1,354 @@
+// Golden frame-stream regression comparator
+//
+// Runs the engine through a scenario on the LoopbackBus and records the frame
+// stream produced, or compares it with a golden capture recorded before.
+// Each poll() cycle is captured as a header word, number of frames in the low
+// 16 bits and button states returned by poll() in the high 16 bits, followed
+// by the frame records of LoopbackBus::frames().
+// The capture is mapped in memory and compared cycle by cycle as the
+// scenario runs, the first differing frame or button state is reported decoded.
+// The check also counts the heap allocations made while the engine runs,
+// the poll() path must not allocate.
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <spaiot-simulator.h>
+#include "engine_p.h"
+
+using namespace SpaIotSimulator;
+
+// record the frame stream of the scenario in the capture file
+int record (const Scenario &scenario, const char *path);
+// compare the frame stream of the scenario with the capture file
+int check (const Scenario &scenario, const char *path);
+// decode a frame record, frame in the low 16 bits and freeze in the high 16 bits
+std::string decode (uint32_t rec);
+// decode the button states returned by poll()
+std::string decodeButtons (int states);
+
+const char *ButtonName[NofButtons] = { "power", "filter", "bubble", "heat", "up", "down", "F/C" };
+
+// number of heap allocations since the start of the program
+std::atomic<unsigned long> allocations (0);
+
+// -----------------------------------------------------------------------------
+void *operator new (size_t size) {
+  void *p = malloc (size ? size : 1);
+
+  if (p == nullptr) {
+
+    throw std::bad_alloc();
+  }
+  allocations++;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+void operator delete (void *p) noexcept {
+
+  free (p);
+}
+
+int main (int argc, char *argv[]) {
+  Scenario scenario;
+
+  if (argc != 4 || (strcmp (argv[1], "record") != 0 && strcmp (argv[1], "check") != 0)) {
+
+    std::cerr << "Usage: " << argv[0] << " record|check scenarioFile captureFile" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  if (!scenario.load (argv[2])) {
+
+    std::cerr << argv[2] << ": " << scenario.error() << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  return strcmp (argv[1], "record") == 0 ? record (scenario, argv[3]) : check (scenario, argv[3]);
+}
+
+// -----------------------------------------------------------------------------
+int record (const Scenario &scenario, const char *path) {
+  LoopbackBus bus;
+  Engine engine (bus);
+  unsigned long count = 0;
+  unsigned long cycles = 0;
+  bool written = true;
+  FILE *f = fopen (path, "wb");
+
+  if (!f) {
+
+    perror (path);
+    return EXIT_FAILURE;
+  }
+  setvbuf (f, nullptr, _IOFBF, 1 << 20);
+  engine.begin();
+
+  scenario.run (engine, bus, [&] (int buttons) {
+    const std::vector<uint32_t> &frames = bus.frames();
+    uint32_t header = frames.size() | (buttons << 16);
+
+    written = fwrite (&header, sizeof (uint32_t), 1, f) == 1 &&
+              fwrite (frames.data(), sizeof (uint32_t), frames.size(), f) == frames.size();
+    count += frames.size();
+    cycles++;
+    return written;
+  });
+
+  if (fclose (f) != 0 || !written) {
+
+    perror (path);
+    return EXIT_FAILURE;
+  }
+  std::cout << count << " frames of " << cycles << " cycles recorded in " << path << std::endl;
+  return EXIT_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+int check (const Scenario &scenario, const char *path) {
+  LoopbackBus bus;
+  Engine engine (bus);
+  struct stat st;
+  const uint32_t *golden = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+  unsigned long count = 0;
+  unsigned long cycle = 0;
+  bool same = true;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int fd = open (path, O_RDONLY);
+
+  if (fd < 0 || fstat (fd, &st) < 0) {
+
+    perror (path);
+    return EXIT_FAILURE;
+  }
+  size = st.st_size / sizeof (uint32_t);
+  if (size) {
+    void *p = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (p == MAP_FAILED) {
+
+      perror (path);
+      close (fd);
+      return EXIT_FAILURE;
+    }
+    madvise (p, st.st_size, MADV_SEQUENTIAL);
+    golden = static_cast<const uint32_t *> (p);
+  }
+
+  bool truncated = false;
+  auto report = [&] (size_t index, const uint32_t *expected, const uint32_t *produced) {
+
+    std::cout << path << ": frame " << count + index << " differs (cycle " << cycle
+              << ", frame " << index << " of the cycle)" << std::endl;
+    std::cout << "  expected: " << (expected ? decode (*expected) : (truncated ? "end of capture" : "end of cycle")) << std::endl;
+    std::cout << "  produced: " << (produced ? decode (*produced) : "end of cycle") << std::endl;
+  };
+
+  std::function<bool (int) > afterPoll = [&] (int buttons) {
+    const std::vector<uint32_t> &frames = bus.frames();
+    size_t n = frames.size();
+    uint32_t header = n | (buttons << 16);
+
+    if (offset == size) {
+
+      std::cout << path << ": cycle " << cycle << " differs" << std::endl;
+      std::cout << "  expected: end of capture" << std::endl;
+      std::cout << "  produced: " << n << " frames" << std::endl;
+      same = false;
+      return false;
+    }
+
+    // frames of the captured cycle, the capture may be truncated
+    const uint32_t *g = golden + offset + 1;
+    size_t expected = std::min<size_t> (golden[offset] & 0xFFFF, size - offset - 1);
+    size_t m = std::min (n, expected);
+
+    truncated = expected < (golden[offset] & 0xFFFF);
+
+    if (memcmp (frames.data(), g, m * sizeof (uint32_t)) != 0 || n != expected) {
+      size_t i = 0;
+
+      while (i < m && frames[i] == g[i]) {
+        i++;
+      }
+      report (i, i < expected ? &g[i] : nullptr, i < n ? &frames[i] : nullptr);
+      same = false;
+      return false;
+    }
+
+    if (golden[offset] != header) {
+
+      std::cout << path << ": button states of cycle " << cycle << " differ" << std::endl;
+      std::cout << "  expected: " << decodeButtons (golden[offset] >> 16) << std::endl;
+      std::cout << "  produced: " << decodeButtons (buttons) << std::endl;
+      same = false;
+      return false;
+    }
+    offset += n + 1;
+    count += n;
+    cycle++;
+    return true;
+  };
+
+  unsigned long allocated = allocations;
+  engine.begin();
+  scenario.run (engine, bus, afterPoll);
+  allocated = allocations - allocated;
+
+  if (same && offset < size) {
+
+    std::cout << path << ": cycle " << cycle << " differs" << std::endl;
+    std::cout << "  expected: " << (golden[offset] & 0xFFFF) << " frames" << std::endl;
+    std::cout << "  produced: end of scenario" << std::endl;
+    same = false;
+  }
+
+  if (golden) {
+
+    munmap (const_cast<uint32_t *> (golden), st.st_size);
+  }
+  close (fd);
+
+  if (same) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << path << ": " << count << " frames and " << cycle << " button states identical, checked in "
+              << std::fixed << std::setprecision (1) << elapsed.count() << " ms, "
+              << allocated << " heap allocations" << std::endl;
+    if (allocated) {
+
+      std::cout << path << ": the engine must not allocate while it runs" << std::endl;
+      same = false;
+    }
+  }
+  return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// -----------------------------------------------------------------------------
+std::string decode (uint32_t rec) {
+  static const char *ledName[NofLeds] = { "power", "filter", "bubble", "heat green", "heat red" };
+  static const char *digitName[] = { "hundreds", "tens", "units", "unit" };
+  uint16_t frame = rec & 0xFFFF;
+  uint16_t low = ~frame; // the active lines are low
+  std::ostringstream s;
+
+  s << "0x" << std::hex << std::setw (4) << std::setfill ('0') << frame << std::dec;
+  s << " freeze " << (rec >> 16) << " us: ";
+
+  int dsp = -1;
+  for (int id = 0; id < 4; id++) {
+
+    if (low & DisplayFlag[id]) {
+
+      dsp = (dsp < 0) ? id : 4; // 4: several digits selected
+    }
+  }
+
+  if (dsp == 4) {
+
+    s << "several digits selected";
+  }
+  else if (dsp >= 0) {
+    uint16_t segments = low & DigitMask;
+
+    s << "digit " << digitName[dsp] << " ";
+    if (segments == 0) {
+
+      s << "blank";
+    }
+    else if (dsp == 3 && segments == DigitC) {
+
+      s << "C";
+    }
+    else if (dsp == 3 && segments == DigitF) {
+
+      s << "F";
+    }
+    else {
+      int d = 0;
+
+      while (d < 10 && DigitFlag[d] != segments) {
+        d++;
+      }
+      if (d < 10) {
+        s << d;
+      }
+      else {
+        s << "unknown segments 0x" << std::hex << segments << std::dec;
+      }
+    }
+  }
+  else if (low & LED) {
+    bool none = true;
+
+    s << "leds";
+    for (int id = 0; id < NofLeds; id++) {
+
+      if (low & LedFlag[id]) {
+
+        s << " " << ledName[id];
+        none = false;
+      }
+    }
+    if (none) {
+
+      s << " off";
+    }
+  }
+  else {
+    int button = -1;
+
+    for (int id = 0; id < NofButtons; id++) {
+
+      if (low & ButtonLine[id]) {
+
+        button = (button < 0) ? id : NofButtons;
+      }
+    }
+    if (button < 0) {
+
+      s << "idle";
+    }
+    else if (button < NofButtons) {
+
+      s << "scan button " << ButtonName[button];
+    }
+    else {
+
+      s << "unknown frame";
+    }
+  }
+
+  if (frame & BUZ) {
+
+    s << ", buzzer on";
+  }
+  return s.str();
+}
+
+// -----------------------------------------------------------------------------
+std::string decodeButtons (int states) {
+  std::string s;
+
+  for (int id = 0; id < NofButtons; id++) {
+
+    if (states & (1 << id)) {
+
+      s += s.empty() ? "pressed " : ", ";
+      s += ButtonName[id];
+    }
+  }
+  return s.empty() ? "no button pressed" : s;
+}
@@ -0,0 +1,95 @@
+#include <spaiot/simulator/loopbackbus.h>
+#include "engine_p.h"
+
+namespace SpaIotSimulator {
+
+  //----------------------------------------------------------------------------
+  LoopbackBus::LoopbackBus() :
+    Bus (-1, -1, -1, -1),
+    m_time (0),
+    m_pressed (0),
+    m_lastFrame (IdleFrame) {
+
+    BusTiming t;
+
+    t.frameNs = DefaultFrameTime * 1000;
+    setTiming (t);
+    m_frames.reserve (MaxFrames);
+  }
+
+  //----------------------------------------------------------------------------
+  void LoopbackBus::setButton (int id, bool pressed) noexcept {
+
+    if (id >= 0 && id < NofButtons) {
+
+      if (pressed) {
+
+        m_pressed |= ButtonLine[id];
+      }
+      else {
+
+        m_pressed &= ~ButtonLine[id];
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  const std::vector<uint32_t> &LoopbackBus::frames() const noexcept {
+
+    return m_frames;
+  }
+
+  //----------------------------------------------------------------------------
+  uint64_t LoopbackBus::time() const noexcept {
+
+    return m_time;
+  }
+
+  //----------------------------------------------------------------------------
+  Status LoopbackBus::begin() noexcept {
+
+    return StatusOk;
+  }
+
+  //----------------------------------------------------------------------------
+  void LoopbackBus::beginCycle() noexcept {
+
+    m_frames.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  void LoopbackBus::transfer (uint16_t data) noexcept {
+
+    if (m_frames.size() < MaxFrames) {
+
+      m_frames.push_back (data);
+    }
+    m_lastFrame = data;
+    m_time += timing().frameNs / 1000;
+  }
+
+  //----------------------------------------------------------------------------
+  void LoopbackBus::freeze (uint16_t us) noexcept {
+
+    if (!m_frames.empty()) {
+      uint32_t &f = m_frames.back();
+      uint32_t d = (f >> 16) + us;
+
+      f = (f & 0xFFFF) | ( (d > 0xFFFF ? 0xFFFF : d) << 16);
+    }
+    m_time += us;
+  }
+
+  //----------------------------------------------------------------------------
+  bool LoopbackBus::dataInPin() noexcept {
+
+    // a pressed button pulls the data in pin low when its line is selected
+    return (~m_lastFrame & m_pressed) == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  BusTiming LoopbackBus::calibrate (uint16_t) {
+
+    return timing();
+  }
+}
@@ -1,7 +1,17 @@
 #include <iostream>
 #include <cstdlib>
 #include <csignal>
-#include <map>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
 #include <spaiot-simulator.h>
 
 using namespace SpaIotSimulator;
@@ -10,16 +20,104 @@ using namespace SpaIotSimulator;
 int strToPin (const char *str);
 // Handle Ctrl+C and SIGTERM
 void signalHandler (int sig);
-void setDevice (int id, bool state);
+// Load or measure the bus timing profile
+void calibrateBus (bool gpio, bool force);
+// Board model and piduino version, the pin costs depend on both
+std::string platform();
+// Print the water temperature of a batch run as CSV, inputs changed by the schedule file if not nullptr
+int thermalBatch (unsigned long hours, const char *schedule);
 
 // The engine instance is global to be able to handle signals
 Engine *engine = nullptr;
-uint16_t tempValue = 0;
+std::unique_ptr<Bus> bus;
+std::unique_ptr<FaultBus> faultBus;
+// Faults injected are appended to this file every FaultFlushPeriod and at exit
+const char *FaultRecordPath = "spaiot-faults.log";
+const std::chrono::seconds FaultFlushPeriod (1);
+SpaDevice *spa = nullptr;
 
 int main (int argc, char *argv[]) {
-  int dataOutPin, clkPin, nWrPin,  dataInPin;
+  int dataOutPin = -1, clkPin = -1, nWrPin = -1,  dataInPin = -1;
+  const char *spiDevice = nullptr;
+  bool queueFreezes = false;
+  const char *progName = argv[0];
+  bool forceCalibration = false;
+  const char *faultSeed = nullptr;
+  const char *faultScript = nullptr;
+  const char *batchHours = nullptr;
+  const char *thermalSchedule = nullptr;
+  uint64_t seed = 0;
+  unsigned long ppm = 1000;
+  int opt;
+
+  while ( (opt = getopt (argc, argv, "b:cf:qr:s:t:")) != -1) {
+
+    switch (opt) {
+      case 'b':
+        batchHours = optarg;
+        break;
+      case 't':
+        thermalSchedule = optarg;
+        break;
+      case 'c':
+        forceCalibration = true;
+        break;
+      case 'f':
+        faultSeed = optarg;
+        break;
+      case 'r':
+        faultScript = optarg;
+        break;
+      case 's':
+        spiDevice = optarg;
+        break;
+      case 'q':
+        queueFreezes = true;
+        break;
+      default:
+        break;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (faultSeed) {
+    char *end;
+    bool valid = *faultSeed >= '0' && *faultSeed <= '9';
+
+    // seed[,ppm], the rate is a probability in parts per million
+    errno = 0;
+    seed = strtoull (faultSeed, &end, 0);
+    if (valid && *end == ',') {
+      const char *rate = end + 1;
 
-  if (argc == 5) {
+      valid = *rate >= '0' && *rate <= '9';
+      ppm = strtoul (rate, &end, 10);
+    }
+    if (!valid || errno != 0 || *end != '\0' || ppm > 1000000) {
+
+      std::cerr << "Invalid fault seed or rate: " << faultSeed << std::endl;
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  if (batchHours) {
+    char *end;
+    unsigned long hours = strtoul (batchHours, &end, 10);
+
+    if (*batchHours < '0' || *batchHours > '9' || *end != '\0' || hours == 0) {
+
+      std::cerr << "Invalid number of hours: " << batchHours << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    exit (thermalBatch (hours, thermalSchedule));
+  }
+
+  if (spiDevice && argc == 2) {
+
+    dataInPin   = strToPin (argv[1]);
+  }
+  else if (!spiDevice && argc == 5) {
 
     dataOutPin = strToPin (argv[1]);
     clkPin  = strToPin (argv[2]);
@@ -27,41 +125,96 @@ int main (int argc, char *argv[]) {
     dataInPin   = strToPin (argv[4]);
   }
 
-  if (argc != 5 || dataOutPin < 0 || clkPin < 0 || nWrPin < 0 || dataInPin < 0) {
+  if (dataInPin < 0 || (!spiDevice && (dataOutPin < 0 || clkPin < 0 || nWrPin < 0 || queueFreezes))) {
 
-    std::cerr << "Usage: " <<  argv[0] << " dataOutPin clkPin nWrPin dataInPin" << std::endl;
+    std::cerr << "Usage: " <<  progName << " [-c] [-f seed[,ppm]] [-r faultScript] dataOutPin clkPin nWrPin dataInPin" << std::endl;
+    std::cerr << "       " <<  progName << " [-f seed[,ppm]] [-r faultScript] [-q] -s spiDevice dataInPin" << std::endl;
+    std::cerr << "       " <<  progName << " -b hours [-t schedule]" << std::endl;
     exit (EXIT_FAILURE);
   }
 
-  engine = new  Engine (dataOutPin, clkPin, nWrPin, dataInPin);
-  engine->begin();
+  if (spiDevice) {
+
+    SpiBus *spiBus = new SpiBus (spiDevice, dataInPin);
+
+    spiBus->setQueueFreezes (queueFreezes);
+    bus.reset (spiBus);
+  }
+  else {
+
+    bus.reset (new Bus (dataOutPin, clkPin, nWrPin, dataInPin));
+  }
+
+  if (faultSeed || faultScript) {
+
+    faultBus.reset (new FaultBus (*bus, seed));
+    if (faultSeed) {
+
+      faultBus->setRate (ppm);
+    }
+    if (faultScript && !faultBus->loadScript (faultScript)) {
+
+      std::cerr << "Unable to read the fault script " << faultScript << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    if (!faultBus->saveRecord (FaultRecordPath)) {
+
+      std::cerr << "Unable to write the fault record " << FaultRecordPath << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    std::cout << "Fault injection enabled, faults recorded in " << FaultRecordPath << std::endl;
+    engine = new Engine (*faultBus);
+  }
+  else {
+
+    engine = new  Engine (*bus);
+  }
+
+  if (engine->begin() != StatusOk) {
 
+    std::cerr << "Unable to start the bus: " << strerror (engine->bus().lastError()) << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  calibrateBus (spiDevice == nullptr, forceCalibration);
+
+  spa = new SpaDevice (*engine, &std::cout);
   signal (SIGINT, signalHandler);
   signal (SIGTERM, signalHandler);
   std::cout << "Press Ctrl+C to abort ..." << std::endl;
 
-  tempValue = engine->display();
-  int previousButtons = 0;
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point lastFlush = last;
 
   for (;;) {
     int buttonStates = engine->poll();
-    int buttonChanges = previousButtons ^ buttonStates;
-
-    if (buttonChanges) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
-      for (int buttonId = 0; buttonChanges != 0; buttonId++) {
-        int buttonFlag = (1 << buttonId);
+    if (buttonStates < 0) {
 
-        if (buttonChanges & buttonFlag) {
-          bool buttonState = (buttonStates & buttonFlag) != 0;
+      std::cerr << "Bus failure: " << strerror (engine->bus().lastError()) << std::endl;
+      if (faultBus) {
 
-          setDevice (buttonId, buttonState);
-          buttonChanges &= ~ buttonFlag;
-        }
+        faultBus->flushRecord (FaultRecordPath);
       }
-      previousButtons = buttonStates;
+      exit (EXIT_FAILURE);
     }
 
+    spa->update (buttonStates, std::chrono::duration_cast<std::chrono::microseconds> (now - last).count());
+    last = now;
+
+    // the fault record is written between two cycles
+    if (faultBus && now - lastFlush >= FaultFlushPeriod) {
+
+      if (faultBus->isRecordFull()) {
+
+        std::cerr << "Warning: fault record full, faults not injected since the last flush" << std::endl;
+      }
+      if (!faultBus->flushRecord (FaultRecordPath)) {
+
+        std::cerr << "Warning: unable to write the fault record " << FaultRecordPath << std::endl;
+      }
+      lastFlush = now;
+    }
   }
   return 0;
 }
@@ -89,82 +242,165 @@ int strToPin (const char *str) {
 }
 
 // -----------------------------------------------------------------------------
-void
-signalHandler (int sig) {
+void calibrateBus (bool gpio, bool force) {
+  std::string path;
+  BusTiming timing;
+  const char *home = getenv ("HOME");
 
-  // endwin();
-  // nocbreak();
-  engine->enableDisplay (false);
-  setDevice (BtnPower, true);
-  engine->poll();
-  setDevice (BtnPower, false);
-  engine->poll();
-  delete engine;
-  std::cout << std::endl << "Have a nice day !" << std::endl;
-  exit (EXIT_SUCCESS);
+  // the profile is only used by the gpio backend, the spi one is calibrated each time
+  if (gpio && home) {
+
+    path = std::string (home) + "/.spaiot-simulator";
+  }
+
+  if (force || path.empty() || !timing.load (path, platform())) {
+
+    std::cout << "Calibrating bus timing for " << platform() << " ..." << std::endl;
+    timing = engine->calibrate();
+    if (!path.empty() && !timing.save (path, platform())) {
+
+      std::cerr << "Unable to save the timing profile to " << path << std::endl;
+    }
+  }
+  engine->bus().setTiming (timing);
+
+  if (gpio) {
+
+    std::cout << "Pin write " << timing.writeNs << " ns, delay overhead " << timing.delayNs << " ns, delays "
+              << timing.clkLow << "/" << timing.dataSetup << "/" << timing.clkHigh << " us" << std::endl;
+  }
+  std::cout << "Frame time " << (timing.frameNs + 500) / 1000 << " us" << std::endl;
 }
 
 // -----------------------------------------------------------------------------
-void setDevice (int id, bool state) {
-
-  static const std::map<int, const char *> labels = {
-    {BtnPower, "Power"},
-    {BtnFilter, "Filter"},
-    {BtnHeat, "Heat"},
-    {BtnBubble, "Bubble"},
-    {BtnFc, "F/C"},
-    {BtnUp, "Up"},
-    {BtnDown, "Down"}
+std::string platform() {
+  std::ifstream f ("/proc/device-tree/model");
+  std::string model;
+
+  // the model is a null terminated string
+  if (! (f && std::getline (f, model, '\0')) || model.empty()) {
+
+    model = "unknown board";
+  }
+  return model + ", piduino " + SPAIOT_PIDUINO_VERSION;
+}
+
+// -----------------------------------------------------------------------------
+int thermalBatch (unsigned long hours, const char *schedule) {
+  // inputs of the schedule, in the order of inputName
+  enum InputId {
+    InSetpoint,
+    InAmbient,
+    InWater,
+    InHeater, // InHeater and the next ones are switches, 0 or 1
+    InFilter,
+    InBubble,
+    NofInputs
   };
+  static const char *inputName[NofInputs] = { "setpoint", "ambient", "water", "heater", "filter", "bubble" };
+  struct Input {
+    unsigned long minute;
+    InputId id;
+    int value;
+  };
+  std::vector<Input> inputs;
+  SpaModel model;
 
-  if (state) {
+  // spa on, filter and heater enabled, setpoint 38°C, ambient 20°C
+  model.setFilter (true);
+  model.setHeater (true);
 
-    engine->setBuzzer (true);
-    switch (id) {
-      case BtnFilter:
-      case BtnHeat:
-      case BtnBubble:
-        if (engine->led (LedPower) == false) {
+  // schedule lines: minute input value, # starts a comment
+  if (schedule) {
+    std::ifstream f (schedule);
+    std::string line;
+    int n = 0;
 
-          break;
-        }
-      case BtnPower:
-        engine->toggleLed (id);
-        if (id == LedPower &&  !engine->led (LedPower)) {
-
-          engine->clearLed (LedFilter);
-          engine->clearLed (LedBubble);
-          engine->clearLed (LedHeater);
-        }
-        break;
+    if (!f) {
 
-      case BtnFc:
-        tempValue = engine->isCelcius() ? Engine::celciusToFahrenheit (tempValue) : Engine::fahrenheitToCelcius (tempValue);
-        engine->setCelcius (!engine->isCelcius());
-        break;
+      std::cerr << "Unable to read the thermal schedule " << schedule << std::endl;
+      return EXIT_FAILURE;
+    }
+    while (std::getline (f, line)) {
+      std::istringstream s (line.substr (0, line.find ('#')));
+      std::string minute, name, extra;
+      char *end = nullptr;
+      Input in = { 0, NofInputs, -1 };
 
-      case BtnUp:
-        if (engine->led (LedPower) && tempValue < 99) {
-          tempValue++;
-          engine->setDisplay (tempValue);
-        }
-        break;
+      n++;
+      if (! (s >> minute)) {
 
-      case BtnDown:
-        if (engine->led (LedPower) && tempValue > 0) {
-          tempValue--;
-          engine->setDisplay (tempValue);
-        }
-        break;
+        continue;
+      }
+      in.minute = strtoul (minute.c_str(), &end, 10);
+      if (minute[0] >= '0' && minute[0] <= '9' && *end == '\0' && s >> name >> in.value && ! (s >> extra)) {
 
-      default:
-        break;
+        in.id = static_cast<InputId> (std::find (inputName, inputName + NofInputs, name) - inputName);
+      }
+      if (in.id == NofInputs || (in.id >= InHeater && (in.value < 0 || in.value > 1))) {
+
+        std::cerr << schedule << ": line " << n << ": invalid input" << std::endl;
+        return EXIT_FAILURE;
+      }
+      inputs.push_back (in);
     }
+    std::stable_sort (inputs.begin(), inputs.end(),
+    [] (const Input & a, const Input & b) { return a.minute < b.minute; });
+  }
+
+  std::vector<Input>::const_iterator next = inputs.begin();
+  std::cout << "minute,temperature,heating" << std::endl << std::fixed << std::setprecision (3);
+  for (unsigned long minute = 0; minute <= hours * 60; minute++) {
 
+    for (; next != inputs.end() && next->minute == minute; ++next) {
+
+      switch (next->id) {
+        case InSetpoint:
+          model.setSetpoint (next->value);
+          break;
+        case InAmbient:
+          model.setAmbient (next->value);
+          break;
+        case InWater:
+          model.setTemperature (next->value);
+          break;
+        case InHeater:
+          model.setHeater (next->value);
+          break;
+        case InFilter:
+          model.setFilter (next->value);
+          break;
+        case InBubble:
+          model.setBubble (next->value);
+          break;
+        default:
+          break;
+      }
+    }
+    std::cout << minute << ',' << model.rawTemperature() / 4294967296.0 << ',' << model.isHeating() << '\n';
+    model.run (60);
   }
-  else {
+  return EXIT_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+void
+signalHandler (int sig) {
 
-    engine->setBuzzer (false);
+  // endwin();
+  // nocbreak();
+  engine->enableDisplay (false);
+  spa->setButton (BtnPower, true);
+  engine->poll();
+  spa->setButton (BtnPower, false);
+  engine->poll();
+  delete spa;
+  delete engine;
+  if (faultBus) {
+
+    faultBus->flushRecord (FaultRecordPath);
+    std::cout << std::endl << faultBus->injected() << " faults injected";
   }
-  std::cout << labels.at (id) << " " << (state ? "press" : "release") << std::endl;
+  std::cout << std::endl << "Have a nice day !" << std::endl;
+  exit (EXIT_SUCCESS);
 }
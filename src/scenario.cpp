@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <spaiot/simulator/scenario.h>
+
+namespace SpaIotSimulator {
+
+  namespace {
+
+    const char *OpName[] = {
+      "led", "display", "enable", "buzzer", "celcius", "button", "poll"
+    };
+
+    const char *LedName[NofLeds] = {
+      "power", "filter", "bubble", "heatgreen", "heatred"
+    };
+
+    const char *ButtonName[NofButtons] = {
+      "power", "filter", "bubble", "heat", "up", "down", "fc"
+    };
+
+    // name or number in 0..count-1, -1 if invalid
+    int toId (const std::string &str, const char *names[], int count) {
+
+      for (int i = 0; i < count; i++) {
+
+        if (str == names[i]) {
+
+          return i;
+        }
+      }
+
+      char *end;
+      long id = strtol (str.c_str(), &end, 10);
+      return (!str.empty() && *end == '\0' && id >= 0 && id < count) ? id : -1;
+    }
+
+    // number in min..max, -1 if invalid
+    long toValue (const std::string &str, long min, long max) {
+      char *end;
+      long value = strtol (str.c_str(), &end, 10);
+
+      return (!str.empty() && *end == '\0' && value >= min && value <= max) ? value : -1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool Scenario::load (const std::string &path) {
+    std::ifstream f (path);
+
+    if (!f) {
+
+      m_error = "unable to open " + path;
+      return false;
+    }
+    return parse (f);
+  }
+
+  //----------------------------------------------------------------------------
+  bool Scenario::parse (std::istream &in) {
+    std::string line;
+    int n = 0;
+
+    while (std::getline (in, line)) {
+      std::vector<std::string> args;
+      std::string arg;
+
+      n++;
+      line = line.substr (0, line.find ('#'));
+      std::istringstream s (line);
+
+      while (s >> arg) {
+
+        args.push_back (arg);
+      }
+      if (!args.empty() && !addStep (args, n)) {
+
+        m_error = "line " + std::to_string (n) + ": " + m_error;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  const std::string &Scenario::error() const {
+
+    return m_error;
+  }
+
+  //----------------------------------------------------------------------------
+  const std::vector<Scenario::Step> &Scenario::steps() const {
+
+    return m_steps;
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned long Scenario::polls() const {
+    unsigned long count = 0;
+
+    for (const Step &step : m_steps) {
+
+      if (step.op == OpPoll) {
+
+        count += step.value;
+      }
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  bool Scenario::run (Engine &engine, LoopbackBus &bus, const std::function<bool (int) > &afterPoll,
+                      std::string *failure) const {
+
+    for (const Step &step : m_steps) {
+      int actual = -1;
+
+      switch (step.op) {
+        case OpLed:
+          engine.setLed (step.id, step.value);
+          break;
+        case OpDisplay:
+          engine.setDisplay (step.value);
+          break;
+        case OpEnable:
+          engine.enableDisplay (step.value);
+          break;
+        case OpBuzzer:
+          engine.setBuzzer (step.value);
+          break;
+        case OpCelcius:
+          engine.setCelcius (step.value);
+          break;
+        case OpButton:
+          bus.setButton (step.id, step.value);
+          break;
+        case OpPoll:
+          for (int i = 0; i < step.value; i++) {
+
+            if (!afterPoll (engine.poll())) {
+
+              return false;
+            }
+          }
+          break;
+        case OpExpectLed:
+          actual = engine.led (step.id);
+          break;
+        case OpExpectDisplay:
+          actual = engine.display();
+          break;
+        case OpExpectEnable:
+          actual = engine.isDisplayEnabled();
+          break;
+        case OpExpectBuzzer:
+          actual = engine.isBuzzing();
+          break;
+        case OpExpectCelcius:
+          actual = engine.isCelcius();
+          break;
+        default:
+          break;
+      }
+
+      if (actual >= 0 && actual != step.value) {
+
+        if (failure) {
+
+          *failure = "line " + std::to_string (step.line) + ": expect " +
+                     OpName[step.op - OpExpectLed] + " " + std::to_string (step.value) +
+                     ", got " + std::to_string (actual);
+        }
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  bool Scenario::addStep (const std::vector<std::string> &args, int line) {
+    Step step = { -1, 0, 0, line };
+    const int nofOps = sizeof (OpName) / sizeof (OpName[0]);
+    size_t first = 0;
+    int expect = 0;
+
+    if (args[0] == "expect") {
+
+      first = 1;
+      expect = OpExpectLed;
+    }
+
+    if (first < args.size()) {
+
+      for (int i = 0; i < nofOps; i++) {
+
+        if (args[first] == OpName[i]) {
+
+          step.op = i;
+        }
+      }
+    }
+
+    // arguments after the op
+    std::vector<std::string> a (args.begin() + std::min<size_t> (first + 1, args.size()), args.end());
+    a.resize (std::max<size_t> (a.size(), 2));
+
+    if (expect && (step.op == OpButton || step.op == OpPoll)) {
+
+      step.op = -1;
+    }
+
+    switch (step.op) {
+      case OpLed:
+        step.id = toId (a[0], LedName, NofLeds);
+        step.value = a.size() == 2 ? toValue (a[1], 0, 1) : -1;
+        break;
+      case OpButton:
+        step.id = toId (a[0], ButtonName, NofButtons);
+        step.value = a.size() == 2 ? toValue (a[1], 0, 1) : -1;
+        break;
+      case OpDisplay:
+        step.value = a[1].empty() ? toValue (a[0], 0, 999) : -1;
+        break;
+      case OpPoll:
+        step.value = a[1].empty() ? toValue (a[0], 0, 1000000000) : -1;
+        break;
+      case OpEnable:
+      case OpBuzzer:
+      case OpCelcius:
+        step.value = a[1].empty() ? toValue (a[0], 0, 1) : -1;
+        break;
+      default:
+        m_error = "unknown step " + args[0] + (first ? " " + a[0] : std::string());
+        return false;
+    }
+
+    if (step.id < 0 || step.value < 0) {
+
+      m_error = "invalid arguments for " + args[0];
+      return false;
+    }
+    if (expect) {
+
+      step.op += expect;
+    }
+    m_steps.push_back (step);
+    return true;
+  }
+}
@@ -0,0 +1,162 @@
+#include <spaiot/simulator/spadevice.h>
+
+namespace SpaIotSimulator {
+
+  // Button labels, indexed by ButtonId
+  const char * const ButtonLabel[NofButtons] = {
+    "Power", "Filter", "Bubble", "Heat", "Up", "Down", "F/C"
+  };
+
+  //----------------------------------------------------------------------------
+  SpaDevice::SpaDevice (Engine &engine, std::ostream *log) :
+    m_engine (engine),
+    m_log (log),
+    m_setpointShown (0),
+    m_previousButtons (0) {
+
+    m_model.setTemperature (m_engine.display());
+    m_tempValue = m_model.setpoint();
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaDevice::update (int buttonStates, uint32_t us) noexcept {
+    int buttonChanges = m_previousButtons ^ buttonStates;
+
+    if (buttonChanges) {
+
+      for (int buttonId = 0; buttonChanges != 0; buttonId++) {
+        int buttonFlag = (1 << buttonId);
+
+        if (buttonChanges & buttonFlag) {
+          bool buttonState = (buttonStates & buttonFlag) != 0;
+
+          setButton (buttonId, buttonState);
+          buttonChanges &= ~ buttonFlag;
+        }
+      }
+      m_previousButtons = buttonStates;
+    }
+    step (us);
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaDevice::setButton (int id, bool state) noexcept {
+
+    if (static_cast<unsigned> (id) >= NofButtons) {
+
+      return;
+    }
+
+    if (state) {
+
+      m_engine.setBuzzer (true);
+      switch (id) {
+        case BtnHeat:
+          if (m_engine.led<LedPower>()) {
+
+            m_model.setHeater (!m_model.isHeaterOn());
+          }
+          break;
+
+        case BtnFilter:
+        case BtnBubble:
+          if (m_engine.led<LedPower>() == false) {
+
+            break;
+          }
+        case BtnPower:
+          m_engine.toggleLed (id);
+          if (id == LedPower &&  !m_engine.led<LedPower>()) {
+
+            m_engine.clearLed<LedFilter>();
+            m_engine.clearLed<LedBubble>();
+            m_engine.clearLed<LedHeater>();
+            m_engine.clearLed<LedHeaterRed>();
+            m_model.setHeater (false);
+          }
+          break;
+
+        case BtnFc:
+          m_tempValue = m_engine.isCelcius() ? Engine::celciusToFahrenheit (m_tempValue) : Engine::fahrenheitToCelcius (m_tempValue);
+          m_engine.setCelcius (!m_engine.isCelcius());
+          break;
+
+        case BtnUp:
+          if (m_engine.led<LedPower>() && m_tempValue < setpointLimit (SetpointMax)) {
+            m_tempValue++;
+            showSetpoint();
+          }
+          break;
+
+        case BtnDown:
+          if (m_engine.led<LedPower>() && m_tempValue > setpointLimit (SetpointMin)) {
+            m_tempValue--;
+            showSetpoint();
+          }
+          break;
+
+        default:
+          break;
+      }
+
+    }
+    else {
+
+      m_engine.setBuzzer (false);
+    }
+
+    if (m_log) {
+
+      *m_log << ButtonLabel[id] << " " << (state ? "press" : "release") << std::endl;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaDevice::step (uint32_t us) noexcept {
+
+    m_model.setFilter (m_engine.led<LedFilter>());
+    m_model.setBubble (m_engine.led<LedBubble>());
+    m_model.step (us);
+
+    m_engine.setLed<LedHeaterGreen> (m_model.isHeaterOn() && !m_model.isHeating());
+    m_engine.setLed<LedHeaterRed> (m_model.isHeating());
+    if (m_setpointShown > us) {
+
+      m_setpointShown -= us;
+    }
+    else {
+      int t = m_model.temperature (m_engine.isCelcius());
+
+      m_setpointShown = 0;
+      m_engine.setDisplay (t < 0 ? 0 : (t > 999 ? 999 : t));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  SpaModel &SpaDevice::model() noexcept {
+
+    return m_model;
+  }
+
+  //----------------------------------------------------------------------------
+  uint16_t SpaDevice::setpoint() const noexcept {
+
+    return m_tempValue;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  void SpaDevice::showSetpoint() noexcept {
+
+    m_model.setSetpoint (m_engine.isCelcius() ? m_tempValue : Engine::fahrenheitToCelcius (m_tempValue));
+    m_engine.setDisplay (m_tempValue);
+    m_setpointShown = SetpointShowTime;
+  }
+
+  //----------------------------------------------------------------------------
+  // protected
+  int SpaDevice::setpointLimit (int celcius) const noexcept {
+
+    return m_engine.isCelcius() ? celcius : Engine::celciusToFahrenheit (celcius);
+  }
+}
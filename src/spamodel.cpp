@@ -0,0 +1,154 @@
+#include <spaiot/simulator/spamodel.h>
+
+namespace SpaIotSimulator {
+
+  // Q31.32 fixed point
+  const int FracBits = 32;
+  const int64_t One = int64_t (1) << FracBits;
+  const int64_t Half = One / 2;
+
+  // 800 liters of water
+  // Heater 2.2 kW: 2200 / (800 * 4186) °C/s
+  const int64_t HeaterRate = int64_t (6.57e-4 * One);
+  // Filter pump heat, 0.05 °C/h
+  const int64_t PumpRate = int64_t (1.4e-5 * One);
+  // Loss coefficient with the cover on, 1 °C/h for 20 °C above the ambient, 1/s
+  const int64_t LossRate = int64_t (1.39e-5 * One);
+  // The bubbles multiply the loss
+  const int BubbleLossFactor = 4;
+  // The heater restarts 1 °C below the setpoint
+  const int64_t Hysteresis = One;
+
+  const uint32_t BatchStep = 1000000;
+
+  //----------------------------------------------------------------------------
+  SpaModel::SpaModel (int ambient, int water) :
+    m_water (water * One),
+    m_ambient (ambient * One),
+    m_setpoint (38 * One),
+    m_heater (false),
+    m_heating (false),
+    m_filter (false),
+    m_bubble (false) {
+
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::step (uint32_t us) noexcept {
+    int64_t rate; // °C/s Q31.32
+
+    if (m_heater) {
+
+      if (m_water >= m_setpoint) {
+
+        m_heating = false;
+      }
+      else if (m_water <= m_setpoint - Hysteresis) {
+
+        m_heating = true;
+      }
+    }
+    else {
+
+      m_heating = false;
+    }
+
+    rate = ( (m_water - m_ambient) * LossRate) >> FracBits;
+    if (m_bubble) {
+
+      rate *= BubbleLossFactor;
+    }
+    rate = -rate;
+    if (m_heating) {
+
+      rate += HeaterRate;
+    }
+    if (m_filter) {
+
+      rate += PumpRate;
+    }
+
+    m_water += (rate * us) / 1000000;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::run (uint32_t seconds) noexcept {
+
+    while (seconds--) {
+
+      step (BatchStep);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int SpaModel::temperature (bool celcius) const noexcept {
+    int64_t t = m_water;
+
+    if (!celcius) {
+
+      t = (t * 9) / 5 + 32 * One;
+    }
+    return static_cast<int> ( (t + Half) >> FracBits);
+  }
+
+  //----------------------------------------------------------------------------
+  int64_t SpaModel::rawTemperature() const noexcept {
+
+    return m_water;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setTemperature (int celcius) noexcept {
+
+    m_water = celcius * One;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setAmbient (int celcius) noexcept {
+
+    m_ambient = celcius * One;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setSetpoint (int celcius) noexcept {
+
+    m_setpoint = celcius * One;
+  }
+
+  //----------------------------------------------------------------------------
+  int SpaModel::setpoint() const noexcept {
+
+    return static_cast<int> (m_setpoint >> FracBits);
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setHeater (bool state) noexcept {
+
+    m_heater = state;
+    m_heating = state && m_water < m_setpoint;
+  }
+
+  //----------------------------------------------------------------------------
+  bool SpaModel::isHeaterOn() const noexcept {
+
+    return m_heater;
+  }
+
+  //----------------------------------------------------------------------------
+  bool SpaModel::isHeating() const noexcept {
+
+    return m_heating;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setFilter (bool state) noexcept {
+
+    m_filter = state;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpaModel::setBubble (bool state) noexcept {
+
+    m_bubble = state;
+  }
+}
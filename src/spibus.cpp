@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <Arduino.h>
+#include <spaiot/simulator/spibus.h>
+
+namespace SpaIotSimulator {
+
+  namespace {
+
+    // The BCM2835 controller does not support SPI_LSB_FIRST,
+    // the bytes are reversed and sent MSB first.
+    uint8_t reverse (uint8_t b) {
+
+      b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+      b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+      b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+      return b;
+    }
+
+    SpiIo systemIo;
+  }
+
+  //----------------------------------------------------------------------------
+  //
+  //                            SpiIo Class
+  //
+  //----------------------------------------------------------------------------
+
+  //----------------------------------------------------------------------------
+  SpiIo::~SpiIo() {
+
+  }
+
+  //----------------------------------------------------------------------------
+  int SpiIo::open (const char *path) {
+
+    return ::open (path, O_RDWR);
+  }
+
+  //----------------------------------------------------------------------------
+  int SpiIo::ioctl (int fd, unsigned long request, void *arg) {
+
+    return ::ioctl (fd, request, arg);
+  }
+
+  //----------------------------------------------------------------------------
+  int SpiIo::close (int fd) {
+
+    return ::close (fd);
+  }
+
+  //----------------------------------------------------------------------------
+  //
+  //                            SpiBus Class
+  //
+  //----------------------------------------------------------------------------
+
+  //----------------------------------------------------------------------------
+  SpiBus::SpiBus (const std::string &device, int dataInPin, uint32_t speedHz, SpiIo *io) :
+    Bus (-1, -1, -1, dataInPin),
+    m_device (device),
+    m_speed (speedHz),
+    m_io (io ? io : &systemIo),
+    m_fd (-1),
+    m_count (0),
+    m_queueFreezes (false) {
+
+    std::memset (m_xfer.data(), 0, sizeof (m_xfer));
+    m_tx.fill (0);
+  }
+
+  //----------------------------------------------------------------------------
+  SpiBus::~SpiBus() {
+
+    if (m_fd >= 0) {
+
+      m_io->close (m_fd);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  Status SpiBus::begin() noexcept {
+    uint8_t mode = SPI_MODE_3;
+    uint8_t bits = 8;
+
+    // begin() called again, the device is reopened
+    if (m_fd >= 0) {
+
+      m_io->close (m_fd);
+      m_fd = -1;
+    }
+    m_count = 0;
+
+    m_fd = m_io->open (m_device.c_str());
+    if (m_fd < 0) {
+
+      setError (errno);
+      return StatusIoError;
+    }
+
+    if (m_io->ioctl (m_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        m_io->ioctl (m_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        m_io->ioctl (m_fd, SPI_IOC_WR_MAX_SPEED_HZ, &m_speed) < 0) {
+
+      setError (errno);
+      m_io->close (m_fd);
+      m_fd = -1;
+      return StatusIoError;
+    }
+    return Bus::begin();
+  }
+
+  //----------------------------------------------------------------------------
+  void SpiBus::transfer (uint16_t data) noexcept {
+
+    if (m_count == MaxBatch) {
+
+      flush();
+    }
+
+    uint8_t *tx = &m_tx[m_count * 2];
+    struct spi_ioc_transfer &x = m_xfer[m_count++];
+
+    tx[0] = reverse (data & 0xFF);
+    tx[1] = reverse (data >> 8);
+    x.tx_buf = reinterpret_cast<uintptr_t> (tx);
+    x.rx_buf = 0;
+    x.len = 2;
+    x.speed_hz = m_speed;
+    x.bits_per_word = 8;
+    x.delay_usecs = 0;
+    x.cs_change = 1; // nWR high between frames
+  }
+
+  //----------------------------------------------------------------------------
+  void SpiBus::freeze (uint16_t us) noexcept {
+
+    if (m_count == 0 || !m_queueFreezes) {
+
+      // nWR is released at the end of the message
+      flush();
+      Bus::freeze (us);
+    }
+    else {
+      struct spi_ioc_transfer &x = m_xfer[m_count - 1];
+      uint32_t d = x.delay_usecs + us;
+
+      x.delay_usecs = d > 0xFFFF ? 0xFFFF : d;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void SpiBus::setQueueFreezes (bool queue) noexcept {
+
+    m_queueFreezes = queue;
+  }
+
+  //----------------------------------------------------------------------------
+  void SpiBus::flush() noexcept {
+
+    if (m_count) {
+
+      // cs_change on the last transfer would leave nWR low after the message
+      m_xfer[m_count - 1].cs_change = 0;
+      int ret = m_io->ioctl (m_fd, SPI_IOC_MESSAGE (m_count), m_xfer.data());
+      m_count = 0;
+      if (ret < 0) {
+
+        setError (errno);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool SpiBus::dataInPin() noexcept {
+
+    flush();
+    return Bus::dataInPin();
+  }
+
+  //----------------------------------------------------------------------------
+  BusTiming SpiBus::calibrate (uint16_t frame) {
+    BusTiming t;
+    uint64_t best = UINT64_MAX;
+
+    flush();
+    for (int r = 0; r < CalibrationRuns; r++) {
+      uint64_t start = nanos();
+
+      transfer (frame);
+      flush();
+      best = std::min (best, nanos() - start);
+    }
+    t.frameNs = best;
+    return t;
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal check macros of the tests, a failed check is printed and counted,
+// the test program returns testResult() from main().
+
+inline int &testFailures() {
+  static int failures = 0;
+
+  return failures;
+}
+
+inline int testResult() {
+
+  return testFailures() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+      testFailures()++; \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+  do { \
+    if (!((actual) == (expected))) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #actual \
+                << " is " << (actual) << ", expected " << (expected) << std::endl; \
+      testFailures()++; \
+    } \
+  } while (0)
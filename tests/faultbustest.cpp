@@ -0,0 +1,77 @@
+// FaultBus record flushed to a file and replayed
+
+#include <cstdio>
+#include <spaiot-simulator.h>
+#include "check.h"
+
+using namespace SpaIotSimulator;
+
+const char *RecordPath = "faultbus-test.log";
+
+// -----------------------------------------------------------------------------
+// frames of count cycles with the faults of fault bus
+std::vector<uint32_t> run (FaultBus &faultBus, LoopbackBus &bus, int count) {
+  Engine engine (faultBus);
+  std::vector<uint32_t> frames;
+
+  engine.begin();
+  engine.setDisplay (38);
+  for (int i = 0; i < count; i++) {
+
+    engine.poll();
+    frames.insert (frames.end(), bus.frames().begin(), bus.frames().end());
+  }
+  return frames;
+}
+
+// -----------------------------------------------------------------------------
+void testFlush() {
+  LoopbackBus bus;
+  FaultBus faultBus (bus, 42, 32);
+  std::vector<uint32_t> faulty;
+  unsigned long injected;
+
+  faultBus.setRate (2000);
+  CHECK (faultBus.saveRecord (RecordPath));
+
+  // the record is emptied by each flush, so it never fills up
+  for (int i = 0; i < 10; i++) {
+    std::vector<uint32_t> f = run (faultBus, bus, 10);
+
+    faulty.insert (faulty.end(), f.begin(), f.end());
+    CHECK (!faultBus.isRecordFull());
+    CHECK (faultBus.flushRecord (RecordPath));
+    CHECK (faultBus.record().empty());
+  }
+  injected = faultBus.injected();
+  CHECK (injected > 32);
+
+  // the flushed faults reproduce the run
+  LoopbackBus replayBus;
+  FaultBus replay (replayBus, 1);
+
+  CHECK (replay.loadScript (RecordPath));
+  CHECK (run (replay, replayBus, 100) == faulty);
+  CHECK_EQUAL (replay.injected(), injected);
+}
+
+// -----------------------------------------------------------------------------
+void testFull() {
+  LoopbackBus bus;
+  FaultBus faultBus (bus, 42, 16);
+
+  // no more fault injected when the record is full
+  faultBus.setRate (20000);
+  run (faultBus, bus, 100);
+  CHECK (faultBus.isRecordFull());
+  CHECK_EQUAL (faultBus.injected(), 16UL);
+}
+
+// -----------------------------------------------------------------------------
+int main() {
+
+  testFlush();
+  testFull();
+  remove (RecordPath);
+  return testResult();
+}
@@ -0,0 +1,97 @@
+// Real-time path without heap allocation
+//
+// Built with -fno-exceptions, counts the heap allocations made by the poll()
+// loop of the engine and of the spa device after begin(), on a LoopbackBus
+// and through a FaultBus as the simulator does with -f.
+#include <cstdlib>
+#include <new>
+#include <spaiot-simulator.h>
+#include "check.h"
+
+using namespace SpaIotSimulator;
+
+// number of heap allocations since the start of the program
+unsigned long allocations = 0;
+
+// -----------------------------------------------------------------------------
+void *operator new (size_t size) {
+  void *p = malloc (size ? size : 1);
+
+  if (p == nullptr) {
+
+    abort(); // no exception
+  }
+  allocations++;
+  return p;
+}
+
+// -----------------------------------------------------------------------------
+void operator delete (void *p) noexcept {
+
+  free (p);
+}
+
+const int Polls = 100000;
+
+// -----------------------------------------------------------------------------
+// poll loop with button presses, led, display and unit changes
+void run (Engine &engine, LoopbackBus &bus) {
+  SpaDevice spa (engine);
+
+  for (int i = 0; i < Polls; i++) {
+    int buttons;
+
+    // a button pressed for 20 cycles every 50 cycles
+    bus.setButton ( (i / 50) % NofButtons, (i % 50) < 20);
+    if (i % 1000 == 0) {
+
+      engine.toggleLed (LedBubble);
+      engine.setBuzzer (!engine.isBuzzing());
+      engine.setCelcius (!engine.isCelcius());
+      CHECK_EQUAL (engine.setLed (NofLeds, true), StatusBadId);
+      CHECK_EQUAL (engine.setDisplay (1000), StatusOutOfRange);
+    }
+    buttons = engine.poll();
+    CHECK (buttons >= 0);
+    spa.update (buttons, 16000);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void testLoopback() {
+  LoopbackBus bus;
+  Engine engine (bus);
+  unsigned long allocated;
+
+  CHECK_EQUAL (engine.begin(), StatusOk);
+  allocated = allocations;
+  run (engine, bus);
+  CHECK_EQUAL (allocations - allocated, 0UL);
+}
+
+// -----------------------------------------------------------------------------
+void testFaultBus (size_t recordSize) {
+  LoopbackBus bus;
+  FaultBus faultBus (bus, 42, recordSize);
+  Engine engine (faultBus);
+  unsigned long allocated;
+
+  // scripted and random faults, the record may fill up
+  faultBus.setRate (1000);
+  faultBus.addFault (Fault {10, 3, FaultBitFlip, 5});
+  faultBus.addFault (Fault {20, 0, FaultStuckButton, BtnUp | (1 << 8)});
+  CHECK_EQUAL (engine.begin(), StatusOk);
+  allocated = allocations;
+  run (engine, bus);
+  CHECK_EQUAL (allocations - allocated, 0UL);
+  CHECK (faultBus.injected() > 0);
+}
+
+// -----------------------------------------------------------------------------
+int main() {
+
+  testLoopback();
+  testFaultBus (65536);
+  testFaultBus (64);
+  return testResult();
+}
@@ -0,0 +1,176 @@
+// SpaModel heater hysteresis and fixed point rates
+//
+// The rates are checked against the exact solution of the model equation
+// over an hour, the Q31.32 temperature against its rounding in °C and °F.
+#include <cmath>
+#include <spaiot-simulator.h>
+#include "check.h"
+
+using namespace SpaIotSimulator;
+
+const double One = 4294967296.0;
+
+// -----------------------------------------------------------------------------
+double celcius (const SpaModel &model) {
+
+  return model.rawTemperature() / One;
+}
+
+// -----------------------------------------------------------------------------
+// temperature change in °C after an hour with the inputs of model
+double hourDelta (SpaModel &model) {
+  double start = celcius (model);
+
+  model.run (3600);
+  return celcius (model) - start;
+}
+
+// -----------------------------------------------------------------------------
+// exact temperature change in °C after an hour, from a difference d with the
+// ambient, a heat rate in °C/h and a loss of 1 °C/h for 20 °C times factor
+double exactDelta (double d, double heat, double factor) {
+  double k = factor / 20.0; // 1/h
+
+  return (heat / k - d) * (1.0 - std::exp (-k));
+}
+
+// -----------------------------------------------------------------------------
+void testHysteresis() {
+  SpaModel model (20, 29);
+  int stops = 0, starts = 0;
+  bool heating;
+
+  model.setSetpoint (30);
+  model.setHeater (true);
+  CHECK (model.isHeating());
+
+  // heats up to the setpoint, cools down to 1°C below, and so on
+  heating = model.isHeating();
+  for (int s = 0; s < 24 * 3600; s++) {
+    double before = celcius (model);
+
+    model.step (1000000);
+    if (model.isHeating() != heating) {
+
+      heating = model.isHeating();
+      if (heating) {
+
+        CHECK (before <= 29.0);
+        starts++;
+      }
+      else {
+
+        CHECK (before >= 30.0);
+        stops++;
+      }
+    }
+    // an overshoot of one step at most
+    CHECK (celcius (model) < 30.01);
+    CHECK (celcius (model) > 28.99);
+  }
+  CHECK (stops > 0);
+  CHECK (starts > 0);
+  CHECK (stops - starts <= 1);
+
+  // a disabled heater does not heat, even below the setpoint
+  model.setTemperature (25);
+  model.setHeater (false);
+  model.step (1000000);
+  CHECK (!model.isHeating());
+  CHECK (!model.isHeaterOn());
+
+  // enabled again, heats at once
+  model.setHeater (true);
+  CHECK (model.isHeating());
+
+  // enabled at the setpoint, does not heat
+  model.setTemperature (30);
+  model.setHeater (true);
+  CHECK (!model.isHeating());
+}
+
+// -----------------------------------------------------------------------------
+void testRates() {
+
+  // heater, water at the ambient temperature: 2.2 kW in 800 l, 2.37 °C/h
+  {
+    SpaModel model (20, 20);
+
+    model.setHeater (true);
+    CHECK (std::fabs (hourDelta (model) - exactDelta (0, 2.365, 1)) < 0.005);
+  }
+  // filter pump, 0.05 °C/h
+  {
+    SpaModel model (20, 20);
+
+    model.setFilter (true);
+    CHECK (std::fabs (hourDelta (model) - exactDelta (0, 0.05, 1)) < 0.001);
+  }
+  // loss, 1 °C/h for 20 °C above the ambient, 4 times more with the bubbles
+  {
+    SpaModel model (20, 40);
+
+    CHECK (std::fabs (hourDelta (model) - exactDelta (20, 0, 1)) < 0.005);
+    model.setTemperature (40);
+    model.setBubble (true);
+    CHECK (std::fabs (hourDelta (model) - exactDelta (20, 0, 4)) < 0.02);
+  }
+  // below the ambient, the water warms up
+  {
+    SpaModel model (30, 10);
+
+    CHECK (std::fabs (hourDelta (model) - exactDelta (-20, 0, 1)) < 0.005);
+  }
+  // a step of one second or a thousand steps of a millisecond
+  {
+    SpaModel a (20, 20), b (20, 20);
+
+    a.setHeater (true);
+    b.setHeater (true);
+    a.step (1000000);
+    for (int i = 0; i < 1000; i++) {
+
+      b.step (1000);
+    }
+    CHECK (std::llabs (a.rawTemperature() - b.rawTemperature()) <= 1000);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void testFixedPoint() {
+  SpaModel model (20, 10);
+
+  // whole degrees
+  CHECK_EQUAL (model.rawTemperature(), int64_t (10) << 32);
+  CHECK_EQUAL (model.temperature(), 10);
+  CHECK_EQUAL (model.temperature (false), 50);
+  model.setTemperature (38);
+  CHECK_EQUAL (model.temperature(), 38);
+  CHECK_EQUAL (model.temperature (false), 100); // 100.4 °F
+  model.setTemperature (40);
+  CHECK_EQUAL (model.temperature (false), 104);
+  model.setSetpoint (37);
+  CHECK_EQUAL (model.setpoint(), 37);
+
+  // rounded to the nearest degree in °C and °F while the water heats
+  model.setTemperature (10);
+  model.setSetpoint (40);
+  model.setHeater (true);
+  for (int minute = 0; minute < 15 * 60; minute++) {
+    double c = celcius (model);
+
+    CHECK_EQUAL (model.temperature(), static_cast<int> (std::floor (c + 0.5)));
+    CHECK_EQUAL (model.temperature (false), static_cast<int> (std::floor (c * 9 / 5 + 32 + 0.5)));
+    model.run (60);
+  }
+  CHECK (model.temperature() >= 39);
+}
+
+// -----------------------------------------------------------------------------
+int main() {
+
+  testHysteresis();
+  testRates();
+  testFixedPoint();
+  return testResult();
+}
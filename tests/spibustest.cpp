@@ -0,0 +1,292 @@
+// SpiBus batches checked with a mock of the spidev system calls
+//
+// The frames sent by SpiBus for a poll() cycle are compared with the record
+// of the same cycle on a LoopbackBus (frame in the low 16 bits, freeze in the high 16 bits).
+#include <cerrno>
+#include <vector>
+#include <sys/ioctl.h>
+#include <spaiot-simulator.h>
+#include "check.h"
+
+using namespace SpaIotSimulator;
+
+// spidev calls recorded instead of being sent
+class MockIo : public SpiIo {
+  public:
+    struct Transfer {
+      uint8_t tx[2];
+      uint32_t len;
+      uint16_t delay;
+      uint8_t csChange;
+    };
+
+    MockIo() : openError (0), failedRequest (0), failMessages (false), mode (0xFF), nextFd (3) {}
+
+    virtual int open (const char *) {
+
+      if (openError) {
+
+        errno = openError;
+        return -1;
+      }
+      return nextFd++;
+    }
+
+    virtual int ioctl (int, unsigned long request, void *arg) {
+
+      if (request == failedRequest) {
+
+        errno = EIO;
+        return -1;
+      }
+
+      if (request == SPI_IOC_WR_MODE) {
+
+        mode = *static_cast<uint8_t *> (arg);
+      }
+      else if (_IOC_TYPE (request) == SPI_IOC_MAGIC && _IOC_NR (request) == 0) {
+        if (failMessages) {
+
+          errno = EIO;
+          return -1;
+        }
+        const struct spi_ioc_transfer *x = static_cast<const struct spi_ioc_transfer *> (arg);
+        size_t n = _IOC_SIZE (request) / sizeof (struct spi_ioc_transfer);
+        std::vector<Transfer> message;
+
+        for (size_t i = 0; i < n; i++) {
+          const uint8_t *tx = reinterpret_cast<const uint8_t *> (x[i].tx_buf);
+
+          message.push_back (Transfer {{tx[0], tx[1]}, x[i].len, x[i].delay_usecs, x[i].cs_change});
+        }
+        messages.push_back (message);
+      }
+      return 0;
+    }
+
+    virtual int close (int fd) {
+
+      closed.push_back (fd);
+      return 0;
+    }
+
+    int openError;
+    unsigned long failedRequest;
+    bool failMessages;
+    uint8_t mode;
+    int nextFd;
+    std::vector<int> closed;
+    std::vector<std::vector<Transfer>> messages;
+};
+
+// -----------------------------------------------------------------------------
+// bit reversal of a byte, bit by bit
+uint8_t reversed (uint8_t b) {
+  uint8_t r = 0;
+
+  for (int i = 0; i < 8; i++) {
+
+    r |= ( (b >> i) & 1) << (7 - i);
+  }
+  return r;
+}
+
+// -----------------------------------------------------------------------------
+// engine state with leds, display and buzzer frames
+void setState (Engine &engine) {
+
+  engine.setLed<LedPower> (true);
+  engine.setLed<LedFilter> (true);
+  engine.setDisplay (38);
+  engine.setBuzzer (true);
+}
+
+// -----------------------------------------------------------------------------
+// frames and freezes of a poll() cycle
+std::vector<uint32_t> reference() {
+  LoopbackBus bus;
+  Engine engine (bus);
+
+  engine.begin();
+  setState (engine);
+  engine.poll();
+  return bus.frames();
+}
+
+// -----------------------------------------------------------------------------
+// frames and freezes sent by the SpiBus, the host freezes are those of the
+// transfers which end a message without delay_usecs
+std::vector<uint32_t> sent (const MockIo &io, bool hostFreezes, const std::vector<uint32_t> &ref) {
+  std::vector<uint32_t> frames;
+
+  for (const std::vector<MockIo::Transfer> &message : io.messages) {
+
+    for (size_t i = 0; i < message.size(); i++) {
+      const MockIo::Transfer &x = message[i];
+      uint32_t frame = reversed (x.tx[0]) | (reversed (x.tx[1]) << 8);
+      uint32_t delay = x.delay;
+
+      CHECK_EQUAL (x.len, 2U);
+      CHECK_EQUAL (x.csChange != 0, i + 1 < message.size());
+      if (hostFreezes && i + 1 == message.size() && frames.size() < ref.size()) {
+
+        // waited by the host after the message, nWR high
+        delay = ref[frames.size()] >> 16;
+      }
+      frames.push_back (frame | (delay << 16));
+    }
+  }
+  return frames;
+}
+
+// -----------------------------------------------------------------------------
+void testBegin() {
+  {
+    MockIo io;
+    SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+
+    io.openError = ENOENT;
+    CHECK_EQUAL (bus.begin(), StatusIoError);
+    CHECK_EQUAL (bus.lastError(), ENOENT);
+  }
+  {
+    MockIo io;
+    {
+      SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+
+      io.failedRequest = SPI_IOC_WR_MAX_SPEED_HZ;
+      CHECK_EQUAL (bus.begin(), StatusIoError);
+      CHECK_EQUAL (bus.lastError(), EIO);
+      // not left half initialised
+      CHECK (io.closed == std::vector<int> {3});
+    }
+    CHECK_EQUAL (io.closed.size(), 1U); // not closed again by the destructor
+  }
+  {
+    MockIo io;
+    {
+      SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+
+      // begin() called twice, the first descriptor is closed
+      CHECK_EQUAL (bus.begin(), StatusOk);
+      CHECK_EQUAL (bus.begin(), StatusOk);
+      CHECK (io.closed == std::vector<int> {3});
+    }
+    CHECK (io.closed == (std::vector<int> {3, 4}));
+  }
+  {
+    MockIo io;
+    {
+      SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+
+      CHECK_EQUAL (bus.begin(), StatusOk);
+      CHECK_EQUAL (bus.lastError(), 0);
+      CHECK_EQUAL (static_cast<int> (io.mode), SPI_MODE_3);
+    }
+    CHECK (io.closed == std::vector<int> {3});
+  }
+}
+
+// -----------------------------------------------------------------------------
+void testBitOrder() {
+  MockIo io;
+  SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+
+  bus.begin();
+  bus.transfer (0x0001);
+  bus.transfer (0x8000);
+  bus.flush();
+
+  // LSB first on a MSB first controller
+  CHECK_EQUAL (io.messages.size(), 1U);
+  CHECK_EQUAL (io.messages[0].size(), 2U);
+  CHECK_EQUAL (static_cast<int> (io.messages[0][0].tx[0]), 0x80);
+  CHECK_EQUAL (static_cast<int> (io.messages[0][0].tx[1]), 0x00);
+  CHECK_EQUAL (static_cast<int> (io.messages[0][1].tx[0]), 0x00);
+  CHECK_EQUAL (static_cast<int> (io.messages[0][1].tx[1]), 0x01);
+}
+
+// -----------------------------------------------------------------------------
+void testQueuedFreezes (const std::vector<uint32_t> &ref) {
+  MockIo io;
+  SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+  Engine engine (bus);
+
+  bus.setQueueFreezes (true);
+  engine.begin();
+  setState (engine);
+  engine.poll();
+
+  // display cycle and first scan frame in the first message, then one per scan frame
+  CHECK_EQUAL (io.messages.size(), static_cast<size_t> (NofButtons));
+  CHECK_EQUAL (io.messages[0].size(), ref.size() - NofButtons + 1);
+  for (size_t i = 1; i < io.messages.size(); i++) {
+
+    CHECK_EQUAL (io.messages[i].size(), 1U);
+  }
+  CHECK (sent (io, false, ref) == ref);
+}
+
+// -----------------------------------------------------------------------------
+void testHostFreezes (const std::vector<uint32_t> &ref) {
+  MockIo io;
+  SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+  Engine engine (bus);
+  size_t freezes = 0;
+
+  engine.begin();
+  setState (engine);
+  engine.poll();
+
+  // a message per freeze, no delay_usecs: nWR is high during the freezes
+  for (uint32_t rec : ref) {
+
+    freezes += (rec >> 16) != 0;
+  }
+  CHECK_EQUAL (io.messages.size(), freezes);
+  for (const std::vector<MockIo::Transfer> &message : io.messages) {
+
+    for (const MockIo::Transfer &x : message) {
+
+      CHECK_EQUAL (x.delay, 0);
+    }
+  }
+  CHECK (sent (io, true, ref) == ref);
+}
+
+// -----------------------------------------------------------------------------
+void testFailure() {
+  MockIo io;
+  SpiBus bus ("/dev/spidev0.0", -1, 100000, &io);
+  Engine engine (bus);
+
+  // a cycle which was not sent is reported by poll()
+  engine.begin();
+  io.failMessages = true;
+  CHECK_EQUAL (engine.poll(), -1);
+  CHECK_EQUAL (bus.lastError(), EIO);
+
+  io.failMessages = false;
+  CHECK_EQUAL (engine.poll(), 0);
+  CHECK_EQUAL (bus.lastError(), 0);
+
+  // through a fault injection bus
+  FaultBus faultBus (bus, 1);
+  Engine faultEngine (faultBus);
+
+  io.failMessages = true;
+  CHECK_EQUAL (faultEngine.poll(), -1);
+  CHECK_EQUAL (faultBus.lastError(), EIO);
+}
+
+// -----------------------------------------------------------------------------
+int main() {
+  std::vector<uint32_t> ref = reference();
+
+  testBegin();
+  testBitOrder();
+  testQueuedFreezes (ref);
+  testHostFreezes (ref);
+  testFailure();
+  return testResult();
+}